@@ -0,0 +1,60 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#include "background_tasks.h"
+
+BackgroundTasks::~BackgroundTasks()
+{
+    for(auto& task: _take([](const Task&) { return true; }))
+        task.thread.join();
+}
+
+void BackgroundTasks::run(const std::string &connection, std::function<void ()> task)
+{
+    // finished threads are joined at once
+    for(auto& finished: _take([](const Task& t) { return t.done->load(); }))
+        finished.thread.join();
+
+    auto done = std::make_shared<std::atomic<bool>>(false);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back({connection, std::thread([task, done]() {
+        task();
+        *done = true;
+    }), done});
+}
+
+void BackgroundTasks::wait(const std::string &connection)
+{
+    for(auto& task: _take([&connection](const Task& t) { return t.connection == connection; }))
+        task.thread.join();
+}
+
+std::list<BackgroundTasks::Task> BackgroundTasks::_take(std::function<bool (const Task&)> match)
+{
+    std::list<Task> result;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(auto it = m_tasks.begin(); it != m_tasks.end();){
+        auto current = it++;
+        if(match(*current))
+            result.splice(result.end(), m_tasks, current);
+    }
+
+    return result;
+}
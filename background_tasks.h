@@ -0,0 +1,57 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifndef CLOUD_STORAGE_BACKGROUND_TASKS_H
+#define CLOUD_STORAGE_BACKGROUND_TASKS_H
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Threads of background requests (listing revalidation) owned by the plugin.
+// They are joined before client of their connection is removed and at plugin unload.
+class BackgroundTasks {
+public:
+    ~BackgroundTasks();
+
+    void run(const std::string &connection, std::function<void ()> task);
+
+    // waits for tasks of the connection
+    void wait(const std::string &connection);
+
+private:
+    struct Task {
+        std::string connection;
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+
+    std::mutex m_mutex;
+    std::list<Task> m_tasks;
+
+    // moves matching tasks out of the list, they are joined without lock
+    std::list<Task> _take(std::function<bool (const Task&)> match);
+};
+
+#endif //CLOUD_STORAGE_BACKGROUND_TASKS_H
@@ -0,0 +1,82 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#include "change_tracker.h"
+
+std::string ChangeTracker::get_cursor(const std::string &connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_states[connection].cursor;
+}
+
+void ChangeTracker::set_cursor(const std::string &connection, const std::string &cursor, bool restored)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    State& state = m_states[connection];
+    state.cursor = cursor;
+    state.restored = restored;
+}
+
+bool ChangeTracker::is_restored(const std::string &connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_states[connection].restored;
+}
+
+bool ChangeTracker::is_tracking(const std::string &connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    State& state = m_states[connection];
+    return !state.unsupported && !state.restored && !state.cursor.empty();
+}
+
+bool ChangeTracker::is_poll_due(const std::string &connection, int interval)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    State& state = m_states[connection];
+    if(state.unsupported)
+        return false;
+
+    auto now = std::chrono::steady_clock::now();
+    if(state.polled && now - state.last_poll < std::chrono::seconds(interval))
+        return false;
+
+    state.polled = true;
+    state.last_poll = now;
+    return true;
+}
+
+void ChangeTracker::set_unsupported(const std::string &connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_states[connection].unsupported = true;
+}
+
+bool ChangeTracker::is_unsupported(const std::string &connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_states[connection].unsupported;
+}
+
+void ChangeTracker::remove(const std::string &connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_states.erase(connection);
+}
@@ -0,0 +1,71 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifndef CLOUD_STORAGE_CHANGE_TRACKER_H
+#define CLOUD_STORAGE_CHANGE_TRACKER_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+#define DEFAULT_CHANGES_POLL_INTERVAL 10
+
+// listings of tracked connections are kept longer, changes invalidate them
+#define TRACKED_LISTING_CACHE_TTL 3600
+
+// Change feed cursors by connection.
+// Cursor is taken from service on first poll, next polls return paths changed since it.
+class ChangeTracker {
+public:
+    std::string get_cursor(const std::string &connection);
+
+    // cursor restored from previous session is not polled yet
+    void set_cursor(const std::string &connection, const std::string &cursor, bool restored = false);
+
+    bool is_restored(const std::string &connection);
+
+    // there is a valid cursor, cached listings are updated by changes
+    bool is_tracking(const std::string &connection);
+
+    // returns true and marks poll time if last poll was more than interval seconds ago
+    bool is_poll_due(const std::string &connection, int interval);
+
+    // service has no change feed
+    void set_unsupported(const std::string &connection);
+
+    bool is_unsupported(const std::string &connection);
+
+    void remove(const std::string &connection);
+
+private:
+    struct State {
+        std::string cursor;
+        std::chrono::steady_clock::time_point last_poll;
+        bool polled = false;
+        bool restored = false;
+        bool unsupported = false;
+    };
+
+    std::mutex m_mutex;
+    std::map<std::string, State> m_states;
+};
+
+#endif //CLOUD_STORAGE_CHANGE_TRACKER_H
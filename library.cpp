@@ -22,6 +22,7 @@ License along with this library; if not, write to the Free Software
 #include <cstring>
 #include <algorithm>
 #include <iomanip>
+#include <thread>
 
 #include "library.h"
 #include "wfxplugin.h"
@@ -29,6 +30,12 @@ License along with this library; if not, write to the Free Software
 #include "json.hpp"
 #include "plugin_utils.h"
 #include "dialogs.h"
+#include "listing_cache.h"
+#include "metadata_store.h"
+#include "change_tracker.h"
+#include "transfer_scheduler.h"
+#include "operation_batch.h"
+#include "background_tasks.h"
 #include "service_clients/service_client.h"
 #include "service_clients/service_factory.h"
 
@@ -36,6 +43,9 @@ License along with this library; if not, write to the Free Software
 #define _plugin_name "Cloud Storage"
 #define _createstr u"/<New connection (F7)>"
 
+// failed files listed in the message at the end of multi-file operation
+#define OPERATION_ERRORS_SHOWN 10
+
 using namespace nlohmann;
 
 int gPluginNumber, gCryptoNr;
@@ -55,6 +65,21 @@ std::map<std::string, std::string> gTokenMap;
 
 ServiceFactory gServiceFactory;
 
+UploadSessions gUploadSessions;
+
+ListingCache gListingCache;
+
+MetadataStore gMetadataStore;
+
+ChangeTracker gChangeTracker;
+
+TransferScheduler gTransferScheduler;
+
+OperationBatch gOperationBatch;
+
+// defined last, so its threads are joined before other globals are destroyed
+BackgroundTasks gBackgroundTasks;
+
 
 void DCPCALL ExtensionInitialize(tExtensionStartupInfo* StartupInfo)
 {
@@ -73,6 +98,48 @@ void DCPCALL FsSetCryptCallbackW(tCryptProcW pCryptProcW, int CryptoNr, int Flag
     gCryptProcW = pCryptProcW;
 }
 
+// restore listings and client mappings saved in previous session,
+// file of unexpected format is removed
+void loadMetadata(const std::string& strConnection)
+{
+    try{
+        json metadata = gMetadataStore.load(strConnection);
+        if(!metadata.is_object())
+            return;
+
+        if(metadata["client"].is_object())
+            gMetadataStore.add_pending(strConnection, metadata["client"]);
+
+        if(metadata["listings"].is_array()){
+            std::vector<WIN32_FIND_DATAW> entries;
+            for(auto& listing: metadata["listings"]){
+                MetadataStore::entries_from_json(listing.at("entries"), entries);
+                gListingCache.restore(strConnection, listing.at("path").get<std::string>(), listing.at("trash").get<bool>(), entries);
+            }
+        }
+
+        if(metadata["changes_cursor"].is_string())
+            gChangeTracker.set_cursor(strConnection, metadata["changes_cursor"].get<std::string>(), true);
+    } catch (std::exception & e){
+        gListingCache.clear(strConnection);
+        gChangeTracker.remove(strConnection);
+        gMetadataStore.remove(strConnection);
+    }
+}
+
+void saveMetadata(const std::string& strConnection, ServiceClient* client)
+{
+    if(!gMetadataStore.is_save_due(strConnection))
+        return;
+
+    json metadata = {
+            {"client", client->get_metadata()},
+            {"listings", gListingCache.get_listings(strConnection)},
+            {"changes_cursor", gChangeTracker.get_cursor(strConnection)}
+    };
+    gMetadataStore.save(strConnection, metadata);
+}
+
 void DCPCALL FsSetDefaultParams(FsDefaultParamStruct* dps)
 {
     std::string defaultIni(dps->DefaultIniName);
@@ -88,6 +155,16 @@ void DCPCALL FsSetDefaultParams(FsDefaultParamStruct* dps)
 
         save_config(gConfig_file_path, gJsonConfig);
     }
+
+    gUploadSessions.load(defaultIni.substr(0, p+1) + "cloud_storage_sessions.json");
+
+    gMetadataStore.open(defaultIni.substr(0, p+1) + "cloud_storage_cache");
+    for(auto& connection: gJsonConfig["connections"]){
+        if(connection["name"].is_string())
+            loadMetadata(connection["name"].get<std::string>());
+    }
+
+    gTransferScheduler.set_workers(gJsonConfig["transfer_workers"].is_number() ? gJsonConfig["transfer_workers"].get<int>() : DEFAULT_TRANSFER_WORKERS);
 }
 
 int DCPCALL FsInitW(int PluginNr, tProgressProcW pProgressProc, tLogProcW pLogProc, tRequestProcW pRequestProc)
@@ -100,13 +177,39 @@ int DCPCALL FsInitW(int PluginNr, tProgressProcW pProgressProc, tLogProcW pLogPr
     return 0;
 }
 
+// transfer settings differ between connections of the same service
+void configureClient(ServiceClient* client, json& connection, const std::string& strConnectionName)
+{
+    client->set_download_segments(connection["download_segments"].is_number() ? connection["download_segments"].get<int>() : DEFAULT_DOWNLOAD_SEGMENTS);
+    client->set_download_segment_size(connection["download_segment_size"].is_number() ? connection["download_segment_size"].get<int>() : DEFAULT_DOWNLOAD_SEGMENT_SIZE);
+    client->set_upload_concurrency(connection["upload_concurrency"].is_number() ? connection["upload_concurrency"].get<int>() : DEFAULT_UPLOAD_CONCURRENCY);
+    client->set_upload_chunk_size(connection["upload_chunk_size"].is_number() ? connection["upload_chunk_size"].get<int>() : DEFAULT_UPLOAD_CHUNK_SIZE);
+    client->set_upload_sessions(&gUploadSessions, strConnectionName);
+
+    httplib::ConnectionPool& pool = client->get_connection_pool();
+    if(gJsonConfig["pool_max_idle_per_host"].is_number())
+        pool.set_max_idle_per_host(gJsonConfig["pool_max_idle_per_host"].get<int>());
+    if(gJsonConfig["pool_idle_timeout"].is_number())
+        pool.set_idle_timeout(gJsonConfig["pool_idle_timeout"].get<int>());
+    if(gJsonConfig["pool_max_active_per_host"].is_number())
+        pool.set_max_active_per_host(gJsonConfig["pool_max_active_per_host"].get<int>());
+}
+
 // get and configure service client
 ServiceClient* getServiceClient(json& gJsonConfig, std::string strConnectionName)
 {
     json& connection = get_connection_config(gJsonConfig, strConnectionName);
     std::string strService = connection["service"].get<std::string>();
 
-    ServiceClient *client = gServiceFactory.getClient(strService);
+    // settings and token of existing client are already set
+    std::pair<ServiceClient*, bool> instance = gServiceFactory.getClient(strService, strConnectionName);
+    ServiceClient *client = instance.first;
+    if(!client)
+        throw std::runtime_error("Unknown service: " + strService);
+
+    BOOL isNewToken = instance.second;
+    if(instance.second)
+        configureClient(client, connection, strConnectionName);
 
     std::string strToken;
     std::map<std::string, std::string>::iterator it;
@@ -114,6 +217,7 @@ ServiceClient* getServiceClient(json& gJsonConfig, std::string strConnectionName
     if(it != gTokenMap.end()){
         strToken = it->second;
     } else {
+        isNewToken = true;
         if(connection["port"].is_number())
             client->set_port(connection["port"].get<int>());
         if(connection["auth_timeout"].is_number())
@@ -126,11 +230,101 @@ ServiceClient* getServiceClient(json& gJsonConfig, std::string strConnectionName
         gTokenMap[connection["name"].get<std::string>()] = strToken;
     }
 
-    client->set_oauth_token(strToken.c_str());
+    if(isNewToken)
+        client->set_oauth_token(strToken.c_str());
+
+    json metadata = gMetadataStore.take_pending(strConnectionName);
+    if(metadata.is_object())
+        client->set_metadata(metadata);
 
     return client;
 }
 
+// copy of the cached folder listing or NULL
+pResources getCachedListing(std::string& strConnection, std::string& strPath, BOOL isTrash)
+{
+    json& connection = get_connection_config(gJsonConfig, strConnection);
+    int ttl = connection["listing_cache_ttl"].is_number() ? connection["listing_cache_ttl"].get<int>() : DEFAULT_LISTING_CACHE_TTL;
+    if(ttl > 0 && gChangeTracker.is_tracking(strConnection))
+        ttl = TRACKED_LISTING_CACHE_TTL;
+
+    pResources pRes = new tResources;
+    pRes->nCount = 0;
+    if(gListingCache.get(strConnection, strPath, isTrash, ttl, pRes->resource_array))
+        return pRes;
+
+    delete pRes;
+    return NULL;
+}
+
+// apply remote changes to the cached listings, first poll only takes the cursor
+void pollChanges(std::string& strConnection, ServiceClient* client)
+{
+    json& connection = get_connection_config(gJsonConfig, strConnection);
+    int interval = connection["changes_poll_interval"].is_number() ? connection["changes_poll_interval"].get<int>() : DEFAULT_CHANGES_POLL_INTERVAL;
+    if(!gChangeTracker.is_poll_due(strConnection, interval))
+        return;
+
+    try{
+        std::string cursor = gChangeTracker.get_cursor(strConnection);
+        json changes = client->get_changes(cursor);
+        if(changes.is_null()){
+            gChangeTracker.set_unsupported(strConnection);
+            return;
+        }
+
+        if(changes["reset"].is_boolean() && changes["reset"].get<bool>()){
+            gListingCache.clear(strConnection);
+        } else if(!cursor.empty() && !changes["paths"].empty()){
+            for(auto& path: changes["paths"])
+                gListingCache.invalidate(strConnection, path.get<std::string>());
+            gListingCache.invalidate_trash(strConnection);
+        }
+
+        // listings from previous session are up to date now
+        if(!cursor.empty() && gChangeTracker.is_restored(strConnection))
+            gListingCache.promote_restored(strConnection);
+
+        gChangeTracker.set_cursor(strConnection, changes["cursor"].get<std::string>());
+    } catch (std::exception & e){
+        // listings are updated by ttl until next successful poll
+    }
+}
+
+// listing with next pages is cached when the last page is received
+void cacheListing(pResources pRes, std::string& strConnection, std::string& strPath, BOOL isTrash, uint64_t version)
+{
+    if(!pRes->next_page){
+        gListingCache.put(strConnection, strPath, isTrash, pRes->resource_array, version);
+        return;
+    }
+
+    auto next_page = pRes->next_page;
+    pRes->next_page = [next_page, strConnection, strPath, isTrash, version](pResources pRes) {
+        bool hasMore = next_page(pRes);
+        if(!hasMore)
+            gListingCache.put(strConnection, strPath, isTrash, pRes->resource_array, version);
+
+        return hasMore;
+    };
+}
+
+// listing is downloaded by the connection's client in background,
+// thread is joined before the client is removed
+void revalidateListing(ServiceClient* client, std::string strConnection, std::string strPath, BOOL isTrash, uint64_t version)
+{
+    gBackgroundTasks.run(strConnection, [=]() {
+        try{
+            std::unique_ptr<tResources> pRes(client->get_resources(strPath, isTrash));
+            while(pRes->next_page && pRes->next_page(pRes.get()));
+
+            gListingCache.put(strConnection, strPath, isTrash, pRes->resource_array, version);
+        } catch (std::exception & e){
+            // listing is downloaded again on the next access
+        }
+    });
+}
+
 HANDLE DCPCALL FsFindFirstW(WCHAR* Path, WIN32_FIND_DATAW *FindData)
 {
     //TODO read config file here?
@@ -158,11 +352,30 @@ HANDLE DCPCALL FsFindFirstW(WCHAR* Path, WIN32_FIND_DATAW *FindData)
     splitPath(wPath, strConnection, strServicePath);
 
     try{
-        ServiceClient *client = getServiceClient(gJsonConfig, strConnection);
         int ifTrash = strServicePath.find("/.Trash");
         if(ifTrash == 0)
             strServicePath = strServicePath.substr(7);
-        pRes = client->get_resources(strServicePath, ifTrash == 0);
+
+        ServiceClient *client = getServiceClient(gJsonConfig, strConnection);
+        pollChanges(strConnection, client);
+
+        pRes = getCachedListing(strConnection, strServicePath, ifTrash == 0);
+        if(!pRes){
+            uint64_t version = gListingCache.get_version();
+
+            // listing from previous session is shown at once and updated in background
+            pRes = new tResources;
+            pRes->nCount = 0;
+            if(gListingCache.take_restored(strConnection, strServicePath, ifTrash == 0, pRes->resource_array)){
+                revalidateListing(client, strConnection, strServicePath, ifTrash == 0, version);
+                saveMetadata(strConnection, client);
+            } else {
+                delete pRes;
+                pRes = client->get_resources(strServicePath, ifTrash == 0);
+                cacheListing(pRes, strConnection, strServicePath, ifTrash == 0, version);
+                saveMetadata(strConnection, client);
+            }
+        }
     } catch (service_client_exception & e){
         if(e.get_status() == 401){
             // remove old token from config and cache, and try to get new one
@@ -194,6 +407,17 @@ BOOL DCPCALL FsFindNextW(HANDLE Hdl, WIN32_FIND_DATAW *FindData)
 {
     pResources pRes = (pResources) Hdl;
 
+    // current page is read, wait for the next one
+    if(pRes && pRes->nCount >= pRes->resource_array.size() && pRes->next_page){
+        try{
+            if(!pRes->next_page(pRes))
+                pRes->next_page = nullptr;
+        } catch (std::exception & e){
+            pRes->next_page = nullptr;
+            gRequestProcW(gPluginNumber, RT_MsgOK, (WCHAR*)u"Error", (WCHAR*) UTF8toUTF16(e.what()).c_str(), NULL, 0);
+        }
+    }
+
     if(pRes && (pRes->nCount < pRes->resource_array.size()) ){
         memcpy(FindData, &pRes->resource_array[pRes->nCount], sizeof(WIN32_FIND_DATAW));
         pRes->nCount++;
@@ -213,6 +437,111 @@ int DCPCALL FsFindClose(HANDLE Hdl){
     return 0;
 }
 
+// services may ignore case of names
+bool hasEntry(const std::vector<WIN32_FIND_DATAW>& entries, std::string strName)
+{
+    std::transform(strName.begin(), strName.end(), strName.begin(), ::tolower);
+    for(auto& entry: entries){
+        std::string strEntry = UTF16toUTF8(entry.cFileName);
+        std::transform(strEntry.begin(), strEntry.end(), strEntry.begin(), ::tolower);
+        if(strEntry == strName)
+            return true;
+    }
+
+    return false;
+}
+
+// true if it is known without request whether remote file exists
+bool getCachedExistence(std::string& strConnection, std::string& strPath, bool& exists)
+{
+    if(gTransferScheduler.is_queued(strConnection, strPath) || gOperationBatch.is_target(strConnection, strPath)){
+        exists = true;
+        return true;
+    }
+
+    size_t p = strPath.find_last_of('/');
+    std::string strFolder = (p == 0) ? "/" : strPath.substr(0, p);
+    std::string strName = strPath.substr(p + 1);
+
+    std::unique_ptr<tResources> pRes(getCachedListing(strConnection, strFolder, false));
+    if(!pRes)
+        return false;
+
+    exists = hasEntry(pRes->resource_array, strName);
+    return true;
+}
+
+// existence of remote file, folder listing is requested when it is not cached
+bool getRemoteExistence(ServiceClient* client, std::string& strConnection, std::string& strPath)
+{
+    bool exists;
+    if(getCachedExistence(strConnection, strPath, exists))
+        return exists;
+
+    size_t p = strPath.find_last_of('/');
+    std::string strFolder = (p == 0) ? "/" : strPath.substr(0, p);
+
+    uint64_t version = gListingCache.get_version();
+    std::unique_ptr<tResources> pRes(client->get_resources(strFolder, false));
+    while(pRes->next_page && pRes->next_page(pRes.get()));
+    gListingCache.put(strConnection, strFolder, false, pRes->resource_array, version);
+
+    return hasEntry(pRes->resource_array, strPath.substr(p + 1));
+}
+
+// one message for all failed files of multi-file operation
+void showOperationErrors(const std::vector<std::string>& errors)
+{
+    if(errors.empty())
+        return;
+
+    std::string message;
+    for(size_t i=0; i<errors.size() && i<OPERATION_ERRORS_SHOWN; i++)
+        message += errors[i] + "\n";
+    if(errors.size() > OPERATION_ERRORS_SHOWN)
+        message += "and " + std::to_string(errors.size() - OPERATION_ERRORS_SHOWN) + " more";
+
+    gRequestProcW(gPluginNumber, RT_MsgOK, (WCHAR*)u"Error", (WCHAR*) UTF8toUTF16(message.c_str()).c_str(), NULL, 0);
+}
+
+// collected operations of the connection, errors are shown when multi-file operation ends
+void runBatch(std::string strConnection, std::vector<BatchOperation> operations)
+{
+    if(operations.empty())
+        return;
+
+    // content of the folder was not moved by one of the previous batches
+    for(auto& operation: operations){
+        if(operation.type == "delete" && gOperationBatch.contains_failed_source(strConnection, operation.from))
+            operation.error = BATCH_DELETE_SKIPPED;
+    }
+
+    try{
+        ServiceClient* client = getServiceClient(gJsonConfig, strConnection);
+        client->run_batch(operations);
+    } catch (std::exception & e){
+        for(auto& operation: operations){
+            if(operation.error.empty())
+                operation.error = e.what();
+        }
+    }
+
+    std::vector<std::string> errors;
+    for(auto& operation: operations){
+        if(!operation.error.empty()){
+            errors.push_back(operation.from + ": " + operation.error);
+            if(operation.type != "delete")
+                gOperationBatch.add_failed_source(strConnection, operation.from);
+        }
+
+        gListingCache.invalidate(strConnection, operation.from);
+        if(!operation.to.empty())
+            gListingCache.invalidate(strConnection, operation.to);
+    }
+    gOperationBatch.add_errors(errors);
+    gListingCache.invalidate_trash(strConnection);
+}
+
 BOOL DCPCALL FsDeleteFileW(WCHAR* RemoteName)
 {
     wcharstring wPath(RemoteName);
@@ -223,10 +552,16 @@ BOOL DCPCALL FsDeleteFileW(WCHAR* RemoteName)
 
     try{
         ServiceClient *client = getServiceClient(gJsonConfig, strConnection);
-        if(strServicePath.find("/.Trash") == 0)
+        if(strServicePath.find("/.Trash") == 0){
             client->deleteFromTrash(strServicePath.substr(7));
-        else
+        } else if(gOperationBatch.is_active() && client->get_batch_limit() > 0){
+            runBatch(strConnection, gOperationBatch.add(strConnection, {"delete", strServicePath, ""}, client->get_batch_limit()));
+            return true;
+        } else {
             client->removeResource(strServicePath);
+            gListingCache.invalidate(strConnection, strServicePath);
+        }
+        gListingCache.invalidate_trash(strConnection);
 
         return true;
     } catch (std::runtime_error & e){
@@ -267,6 +602,10 @@ BOOL DCPCALL FsMkDirW(WCHAR* Path)
     try{
         ServiceClient *client = getServiceClient(gJsonConfig, strConnection);
         client->makeFolder(strServicePath);
+        gListingCache.invalidate(strConnection, strServicePath);
+
+        // files can be put into the new folder without existence check
+        gListingCache.put(strConnection, strServicePath, false, std::vector<WIN32_FIND_DATAW>(), gListingCache.get_version());
         return true;
     } catch (std::runtime_error & e){
         gRequestProcW(gPluginNumber, RT_MsgOK, (WCHAR*)u"Error", (WCHAR*) UTF8toUTF16(e.what()).c_str(), NULL, 0);
@@ -284,6 +623,11 @@ BOOL DCPCALL FsRemoveDirW(WCHAR* RemoteName)
         json::iterator it = get_connection_iter(gJsonConfig["connections"], strName);
         gJsonConfig["connections"].erase(it);
         save_config(gConfig_file_path, gJsonConfig);
+        gBackgroundTasks.wait(strName);
+        gListingCache.clear(strName);
+        gMetadataStore.remove(strName);
+        gChangeTracker.remove(strName);
+        gServiceFactory.removeClient(strName);
 
         return true;
     }
@@ -298,9 +642,14 @@ BOOL DCPCALL FsRemoveDirW(WCHAR* RemoteName)
             BOOL bRes = gRequestProcW(gPluginNumber, RT_MsgOKCancel, (WCHAR*)u"Warning", (WCHAR*)u"Do you want to clean trash?", NULL, 0);
             if(bRes != 0)
                 client->cleanTrash();
+        } else if(gOperationBatch.is_active() && client->get_batch_limit() > 0){
+            runBatch(strConnection, gOperationBatch.add(strConnection, {"delete", strServicePath, ""}, client->get_batch_limit()));
+            return true;
         } else {
             client->removeResource(strServicePath);
+            gListingCache.invalidate(strConnection, strServicePath);
         }
+        gListingCache.invalidate_trash(strConnection);
 
         return true;
     } catch (std::runtime_error & e){
@@ -333,6 +682,11 @@ int DCPCALL FsRenMovFileW(WCHAR* OldName, WCHAR* NewName, BOOL Move, BOOL OverWr
         json::iterator it = get_connection_iter(gJsonConfig["connections"], strOldName);
         (*it)["name"] = newName;
         save_config(gConfig_file_path, gJsonConfig);
+        gBackgroundTasks.wait(strOldName);
+        gListingCache.clear(strOldName);
+        gMetadataStore.remove(strOldName);
+        gChangeTracker.remove(strOldName);
+        gServiceFactory.removeClient(strOldName);
 
         return FS_FILE_OK;
     }
@@ -348,11 +702,31 @@ int DCPCALL FsRenMovFileW(WCHAR* OldName, WCHAR* NewName, BOOL Move, BOOL OverWr
 
         ServiceClient* client = getServiceClient(gJsonConfig, strConnection);
 
+        // target which is known to be free is moved or copied in batch
+        bool exists;
+        if(gOperationBatch.is_active() && client->get_batch_limit() > 0
+           && getCachedExistence(strConnection, strServiceNewPath, exists)){
+            if(exists && !OverWrite)
+                return FS_FILE_EXISTS;
+
+            if(!exists){
+                BatchOperation operation = {Move ? "move" : "copy", strServiceOldPath, strServiceNewPath};
+                runBatch(strConnection, gOperationBatch.add(strConnection, operation, client->get_batch_limit()));
+                gProgressProcW(gPluginNumber, OldName, NewName, 100);
+                return FS_FILE_OK;
+            }
+        }
+
+        // this operation can depend on the collected ones
+        runBatch(strConnection, gOperationBatch.take(strConnection));
+
         if(Move){
             client->move(strServiceOldPath, strServiceNewPath, OverWrite);
+            gListingCache.invalidate(strConnection, strServiceOldPath);
         } else {
             client->copy(strServiceOldPath, strServiceNewPath, OverWrite);
         }
+        gListingCache.invalidate(strConnection, strServiceNewPath);
         gProgressProcW(gPluginNumber, OldName, NewName, 100);
     } catch(service_client_exception & e){
         if(e.get_status() == 409){
@@ -369,11 +743,31 @@ int DCPCALL FsRenMovFileW(WCHAR* OldName, WCHAR* NewName, BOOL Move, BOOL OverWr
     return FS_FILE_OK;
 }
 
-int DCPCALL FsGetFileW(WCHAR* RemoteName, WCHAR* LocalName, int CopyFlags, RemoteInfoStruct* ri)
+// percent of transferred bytes for the plugin progress bar, false if user pressed cancel
+TransferProgress::Callback makeProgressCallback(WCHAR* SourceName, WCHAR* TargetName)
 {
-    if(CopyFlags & FS_COPYFLAGS_RESUME)
-        return FS_FILE_NOTSUPPORTED;
+    return [SourceName, TargetName](uint64_t done, uint64_t total) {
+        int percent = (total > 0) ? (int) (done * 100 / total) : 0;
+        return gProgressProcW(gPluginNumber, SourceName, TargetName, percent) == 0;
+    };
+}
+
+// background task of the current multi-file operation
+TransferTask makeTransferTask(std::string& strConnection, std::string& strPath, ServiceClient* client)
+{
+    json& connection = get_connection_config(gJsonConfig, strConnection);
+
+    TransferTask task;
+    task.connection = strConnection;
+    task.path = strPath;
+    task.connection_limit = connection["transfer_concurrency"].is_number() ? connection["transfer_concurrency"].get<int>() : DEFAULT_TRANSFER_CONCURRENCY;
+    task.client = client;
+
+    return task;
+}
 
+int DCPCALL FsGetFileW(WCHAR* RemoteName, WCHAR* LocalName, int CopyFlags, RemoteInfoStruct* ri)
+{
     // do not allow copy files from the root
     if(isConnectionName(RemoteName))
         return FS_FILE_NOTSUPPORTED;
@@ -384,10 +778,20 @@ int DCPCALL FsGetFileW(WCHAR* RemoteName, WCHAR* LocalName, int CopyFlags, Remot
         std::replace(wRemoteName.begin(), wRemoteName.end(), u'\\', u'/');
 
         BOOL isFileExists = file_exists(UTF16toUTF8(wLocalName.data()));
-        if(isFileExists && !(CopyFlags & FS_COPYFLAGS_OVERWRITE) )
-            return FS_FILE_EXISTS;
+        if(isFileExists && !(CopyFlags & (FS_COPYFLAGS_OVERWRITE | FS_COPYFLAGS_RESUME)) )
+            return FS_FILE_EXISTSRESUMEALLOWED;
+
+        uint64_t offset = 0;
+        if(isFileExists && (CopyFlags & FS_COPYFLAGS_RESUME)){
+            offset = get_file_size(UTF16toUTF8(wLocalName.data()));
+            // local file is already complete
+            if(ri && offset >= (((uint64_t) ri->SizeHigh << 32) | ri->SizeLow))
+                return FS_FILE_OK;
 
-        ofs.open(UTF16toUTF8(wLocalName.data()), std::ios::binary | std::ofstream::out | std::ios::trunc);
+            ofs.open(UTF16toUTF8(wLocalName.data()), std::ios::binary | std::ofstream::out | std::ios::app);
+        } else {
+            ofs.open(UTF16toUTF8(wLocalName.data()), std::ios::binary | std::ofstream::out | std::ios::trunc);
+        }
         if(!ofs || ofs.bad())
             return FS_FILE_WRITEERROR;
 
@@ -398,13 +802,48 @@ int DCPCALL FsGetFileW(WCHAR* RemoteName, WCHAR* LocalName, int CopyFlags, Remot
         std::string strConnection, strServicePath;
         splitPath(wRemoteName, strConnection, strServicePath);
 
+        // small files of multi-file operation are downloaded by transfer workers,
+        // empty files can be exported documents which are not downloaded directly.
+        // Moved files are downloaded here, source folder is removed right after its files are returned
+        uint64_t size = ri ? (((uint64_t) ri->SizeHigh << 32) | ri->SizeLow) : 0;
+        if(gTransferScheduler.is_active() && !(CopyFlags & (FS_COPYFLAGS_RESUME | FS_COPYFLAGS_MOVE)) && size > 0 && size <= BACKGROUND_TRANSFER_MAX_SIZE){
+            ofs.close();
+
+            ServiceClient* client = getServiceClient(gJsonConfig, strConnection);
+            TransferTask task = makeTransferTask(strConnection, strServicePath, client);
+            std::string strLocalPath = UTF16toUTF8(wLocalName.data());
+
+            task.run = [strServicePath, strLocalPath](ServiceClient* client, TransferProgress& progress) {
+                std::ofstream ofs(strLocalPath, std::ios::binary | std::ofstream::out | std::ios::trunc);
+                if(!ofs)
+                    throw std::runtime_error("Cannot open file for writing: " + strLocalPath);
+
+                client->downloadFile(strServicePath, ofs, strLocalPath, 0, &progress);
+                ofs.close();
+            };
+
+            if(!gTransferScheduler.enqueue(task, [RemoteName, LocalName]() {
+                return gProgressProcW(gPluginNumber, RemoteName, LocalName, 0) == 0;
+            }))
+                return FS_FILE_USERABORT;
+
+            gProgressProcW(gPluginNumber, RemoteName, LocalName, 100);
+            return FS_FILE_OK;
+        }
+
+        TransferProgress progress(makeProgressCallback(RemoteName, LocalName));
+        if(ri)
+            progress.set_total(((uint64_t) ri->SizeHigh << 32) | ri->SizeLow);
+
         ServiceClient* client = getServiceClient(gJsonConfig, strConnection);
-        client->downloadFile(strServicePath, ofs, UTF16toUTF8(wLocalName.data()));
+        client->downloadFile(strServicePath, ofs, UTF16toUTF8(wLocalName.data()), offset, &progress);
         gProgressProcW(gPluginNumber, RemoteName, LocalName, 100);
 
         if(CopyFlags & FS_COPYFLAGS_MOVE)
             FsDeleteFileW(RemoteName);
 
+    } catch (transfer_cancelled_exception & e){
+        return FS_FILE_USERABORT;
     } catch (std::runtime_error & e){
         gRequestProcW(gPluginNumber, RT_MsgOK, (WCHAR*)u"Error", (WCHAR*) UTF8toUTF16(e.what()).c_str(), NULL, 0);
         return FS_FILE_READERROR;
@@ -415,9 +854,6 @@ int DCPCALL FsGetFileW(WCHAR* RemoteName, WCHAR* LocalName, int CopyFlags, Remot
 }
 
 int DCPCALL FsPutFileW(WCHAR* LocalName, WCHAR* RemoteName, int CopyFlags) {
-    if (CopyFlags & FS_COPYFLAGS_RESUME)
-        return FS_FILE_NOTSUPPORTED;
-
     // do not allow copy files to the root
     if(isConnectionName(RemoteName))
         return FS_FILE_NOTSUPPORTED;
@@ -426,27 +862,79 @@ int DCPCALL FsPutFileW(WCHAR* LocalName, WCHAR* RemoteName, int CopyFlags) {
         wcharstring wRemoteName(RemoteName), wLocalName(LocalName);
         std::replace(wRemoteName.begin(), wRemoteName.end(), u'\\', u'/');
 
-        std::ifstream ifs;
-        ifs.open(UTF16toUTF8(wLocalName.data()), std::ios::binary | std::ofstream::in);
-        if (!ifs || ifs.bad())
+        std::string strConnection, strServicePath;
+        splitPath(wRemoteName, strConnection, strServicePath);
+
+        // unfinished upload of the same local file can be continued,
+        // resume is offered when the remote file exists, otherwise there is nothing to ask about
+        json session = gUploadSessions.get(strConnection, strServicePath);
+        if(session.is_object()){
+            if(CopyFlags & FS_COPYFLAGS_OVERWRITE){
+                gUploadSessions.remove(strConnection, strServicePath);
+            } else if(!(CopyFlags & FS_COPYFLAGS_RESUME) && session["size"] == get_file_size(UTF16toUTF8(wLocalName.data()))
+                      && getRemoteExistence(getServiceClient(gJsonConfig, strConnection), strConnection, strServicePath)){
+                return FS_FILE_EXISTSRESUMEALLOWED;
+            }
+        }
+
+        // small files of multi-file operation are uploaded by transfer workers,
+        // when existence of the remote file is known from cached listings.
+        // Moved files are uploaded here, source folder is removed right after its files are returned
+        std::string strLocalPath = UTF16toUTF8(wLocalName.data());
+        int64_t localSize = get_file_size(strLocalPath);
+        bool exists;
+        if(gTransferScheduler.is_active() && !(CopyFlags & (FS_COPYFLAGS_RESUME | FS_COPYFLAGS_MOVE))
+           && localSize >= 0 && localSize <= BACKGROUND_TRANSFER_MAX_SIZE
+           && getCachedExistence(strConnection, strServicePath, exists)){
+            if(exists && !(CopyFlags & FS_COPYFLAGS_OVERWRITE))
+                return FS_FILE_EXISTS;
+
+            ServiceClient* client = getServiceClient(gJsonConfig, strConnection);
+            TransferTask task = makeTransferTask(strConnection, strServicePath, client);
+            BOOL overwrite = CopyFlags & FS_COPYFLAGS_OVERWRITE;
+
+            task.run = [strServicePath, strLocalPath, overwrite](ServiceClient* client, TransferProgress& progress) {
+                UploadSource source;
+                if(!source.open(strLocalPath))
+                    throw std::runtime_error("Cannot read file: " + strLocalPath);
+
+                source.set_progress(&progress);
+                client->uploadFile(strServicePath, source, overwrite, false);
+                source.close();
+            };
+
+            if(!gTransferScheduler.enqueue(task, [LocalName, RemoteName]() {
+                return gProgressProcW(gPluginNumber, LocalName, RemoteName, 0) == 0;
+            }))
+                return FS_FILE_USERABORT;
+
+            gProgressProcW(gPluginNumber, LocalName, RemoteName, 100);
+            return FS_FILE_OK;
+        }
+
+        UploadSource source;
+        if (!source.open(strLocalPath))
             return FS_FILE_READERROR;
 
         int err = gProgressProcW(gPluginNumber, LocalName, RemoteName, 0);
         if (err)
             return FS_FILE_USERABORT;
 
-        std::string strConnection, strServicePath;
-        splitPath(wRemoteName, strConnection, strServicePath);
+        TransferProgress progress(makeProgressCallback(LocalName, RemoteName), source.size());
+        source.set_progress(&progress);
 
         ServiceClient* client = getServiceClient(gJsonConfig, strConnection);
-        client->uploadFile(strServicePath, ifs, (CopyFlags & FS_COPYFLAGS_OVERWRITE));
+        client->uploadFile(strServicePath, source, (CopyFlags & FS_COPYFLAGS_OVERWRITE), (CopyFlags & FS_COPYFLAGS_RESUME));
+        gListingCache.invalidate(strConnection, strServicePath);
         gProgressProcW(gPluginNumber, LocalName, RemoteName, 100);
 
-        ifs.close();
+        source.close();
 
         if(CopyFlags & FS_COPYFLAGS_MOVE)
             std::remove(UTF16toUTF8(LocalName).c_str());
 
+    } catch(transfer_cancelled_exception & e){
+        return FS_FILE_USERABORT;
     } catch(service_client_exception & e){
         if(e.get_status() == 409){
             return FS_FILE_EXISTS;
@@ -471,6 +959,50 @@ void DCPCALL FsStatusInfoW(WCHAR* RemoteDir, int InfoStartEnd, int InfoOperation
         else
             gIsFolderRemoving = false;
     }
+
+    if(InfoOperation == FS_STATUS_OP_GET_MULTI || InfoOperation == FS_STATUS_OP_PUT_MULTI){
+        if(InfoStartEnd == FS_STATUS_START){
+            gTransferScheduler.begin();
+            return;
+        }
+
+        // files are reported done when queued, wait for the rest of operation
+        std::vector<std::string> errors;
+        std::set<std::pair<std::string, std::string>> paths;
+        bool hasTasks = gTransferScheduler.end([RemoteDir](size_t done, size_t total) {
+            int percent = (total > 0) ? (int) (done * 100 / total) : 0;
+            return gProgressProcW(gPluginNumber, RemoteDir, RemoteDir, percent) == 0;
+        }, errors, paths);
+
+        if(!hasTasks)
+            return;
+
+        std::set<std::string> connections;
+        for(auto& path: paths){
+            gListingCache.invalidate(path.first, path.second);
+            connections.insert(path.first);
+        }
+        for(auto& connection: connections)
+            gListingCache.invalidate_trash(connection);
+
+        showOperationErrors(errors);
+    }
+
+    if(InfoOperation == FS_STATUS_OP_DELETE || InfoOperation == FS_STATUS_OP_RENMOV_MULTI){
+        if(InfoStartEnd == FS_STATUS_START){
+            gOperationBatch.begin();
+            return;
+        }
+
+        if(!gOperationBatch.is_active())
+            return;
+
+        for(auto& it: gOperationBatch.end())
+            runBatch(it.first, it.second);
+
+        if(!gOperationBatch.is_active())
+            showOperationErrors(gOperationBatch.take_errors());
+    }
 }
 
 int DCPCALL FsExecuteFileW(HWND MainWin, WCHAR* RemoteName, WCHAR* Verb)
@@ -518,8 +1050,14 @@ int DCPCALL FsExecuteFileW(HWND MainWin, WCHAR* RemoteName, WCHAR* Verb)
             std::string strName = UTF16toUTF8(RemoteName + 1);
             json::object_t *obj = get_connection_ptr(gJsonConfig, strName);
             int res = show_connection_properties_dlg(obj);
-            if(res)
+            if(res){
                 save_config(gConfig_file_path, gJsonConfig);
+                gBackgroundTasks.wait(strName);
+                gListingCache.clear(strName);
+                gMetadataStore.remove(strName);
+                gChangeTracker.remove(strName);
+                gServiceFactory.removeClient(strName);
+            }
         }
     }
 
@@ -529,6 +1067,38 @@ int DCPCALL FsExecuteFileW(HWND MainWin, WCHAR* RemoteName, WCHAR* Verb)
         if(wStrings.size() == 0)
             return FS_EXEC_ERROR;
 
+        // connection pool and TLS statistics, available from any folder
+        if(wStrings[0] == (WCHAR*)u"stats"){
+            httplib::ConnectionPoolStats stats;
+            for(ServiceClient* client: gServiceFactory.getClients()){
+                httplib::ConnectionPoolStats clientStats = client->get_connection_pool().get_stats();
+                stats.created += clientStats.created;
+                stats.reused += clientStats.reused;
+                stats.evicted += clientStats.evicted;
+                stats.waited += clientStats.waited;
+                stats.idle += clientStats.idle;
+                stats.active += clientStats.active;
+            }
+            httplib::SSLSessionCacheStats tlsStats = ServiceClient::get_session_cache().get_stats();
+            ListingCacheStats listingStats = gListingCache.get_stats();
+            uint64_t total = stats.created + stats.reused;
+            std::stringstream s;
+            s << "Connections created: " << stats.created << "\n";
+            s << "Connections reused: " << stats.reused;
+            if(total > 0)
+                s << " (" << (stats.reused * 100 / total) << "%)";
+            s << "\n";
+            s << "Connections evicted: " << stats.evicted << "\n";
+            s << "Requests waited for connection: " << stats.waited << "\n";
+            s << "Idle connections: " << stats.idle << "\n";
+            s << "Active connections: " << stats.active << "\n";
+            s << "TLS handshakes full: " << tlsStats.full << ", resumed: " << tlsStats.resumed << "\n";
+            s << "Listing cache hits: " << listingStats.hits << ", misses: " << listingStats.misses << ", folders: " << listingStats.entries;
+
+            gRequestProcW(gPluginNumber, RT_MsgOK, (WCHAR*)u"Statistics", (WCHAR*) UTF8toUTF16(s.str()).c_str(), NULL, 0);
+            return FS_EXEC_OK;
+        }
+
         if( !isConnectionName(RemoteName) ){
             std::string strConnection, strServicePath;
             splitPath(RemoteName, strConnection, strServicePath);
@@ -540,6 +1110,8 @@ int DCPCALL FsExecuteFileW(HWND MainWin, WCHAR* RemoteName, WCHAR* Verb)
                     strings.push_back(UTF16toUTF8(s.c_str()));
 
                 client->run_command(strServicePath, strings);
+                // commands can change any folder
+                gListingCache.clear(strConnection);
             } catch (std::runtime_error & e){
                 gRequestProcW(gPluginNumber, RT_MsgOK, (WCHAR*)u"Error", (WCHAR*) UTF8toUTF16(e.what()).c_str(), NULL, 0);
                 return FS_EXEC_ERROR;
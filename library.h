@@ -1,12 +1,15 @@
 #ifndef CLOUD_STORAGE_LIBRARY_H
 #define CLOUD_STORAGE_LIBRARY_H
 
+#include <functional>
 #include <vector>
 #include "common.h"
 
-typedef struct {
+typedef struct tResources {
     int nCount;
     std::vector<WIN32_FIND_DATAW> resource_array;
+    // appends next page of the listing to resource_array, returns false when there are no more entries
+    std::function<bool (tResources*)> next_page;
 } tResources, *pResources;
 
 typedef std::basic_string<WCHAR> wcharstring;
@@ -0,0 +1,167 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#include "listing_cache.h"
+#include "metadata_store.h"
+
+bool ListingCache::get(const std::string &connection, const std::string &path, BOOL isTrash, int ttl,
+                       std::vector<WIN32_FIND_DATAW> &entries)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_listings[connection].find(Key(path, isTrash));
+    if(it == m_listings[connection].end() || it->second.restored || ttl <= 0 ||
+            std::chrono::steady_clock::now() - it->second.time > std::chrono::seconds(ttl)){
+        m_stats.misses++;
+        return false;
+    }
+
+    entries = it->second.entries;
+    m_stats.hits++;
+    return true;
+}
+
+uint64_t ListingCache::get_version()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_version;
+}
+
+void ListingCache::put(const std::string &connection, const std::string &path, BOOL isTrash,
+                       const std::vector<WIN32_FIND_DATAW> &entries, uint64_t version)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // something was changed while listing was downloaded
+    if(version != m_version)
+        return;
+
+    Listing& listing = m_listings[connection][Key(path, isTrash)];
+    listing.entries = entries;
+    listing.time = std::chrono::steady_clock::now();
+    listing.restored = false;
+}
+
+void ListingCache::restore(const std::string &connection, const std::string &path, BOOL isTrash,
+                           const std::vector<WIN32_FIND_DATAW> &entries)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Listing& listing = m_listings[connection][Key(path, isTrash)];
+    listing.entries = entries;
+    listing.time = std::chrono::steady_clock::now();
+    listing.restored = true;
+}
+
+bool ListingCache::take_restored(const std::string &connection, const std::string &path, BOOL isTrash,
+                                 std::vector<WIN32_FIND_DATAW> &entries)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_listings[connection].find(Key(path, isTrash));
+    if(it == m_listings[connection].end() || !it->second.restored)
+        return false;
+
+    entries.swap(it->second.entries);
+    m_listings[connection].erase(it);
+    return true;
+}
+
+void ListingCache::promote_restored(const std::string &connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for(auto& it: m_listings[connection]){
+        if(it.second.restored){
+            it.second.restored = false;
+            it.second.time = std::chrono::steady_clock::now();
+        }
+    }
+}
+
+json ListingCache::get_listings(const std::string &connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    json js = json::array();
+    for(auto& it: m_listings[connection]){
+        js.push_back({
+            {"path", it.first.first},
+            {"trash", it.first.second != 0},
+            {"entries", MetadataStore::entries_to_json(it.second.entries)}
+        });
+    }
+
+    return js;
+}
+
+void ListingCache::invalidate(const std::string &connection, const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_version++;
+
+    std::string parent("/");
+    std::string::size_type p = path.find_last_of('/');
+    if(p != std::string::npos && p > 0)
+        parent = path.substr(0, p);
+
+    std::string prefix = (path == "/") ? path : path + "/";
+
+    auto& listings = m_listings[connection];
+    for(auto it = listings.begin(); it != listings.end();){
+        const std::string& folder = it->first.first;
+        if(!it->first.second && (folder == parent || folder == path || folder.compare(0, prefix.size(), prefix) == 0))
+            it = listings.erase(it);
+        else
+            ++it;
+    }
+}
+
+void ListingCache::invalidate_trash(const std::string &connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_version++;
+
+    auto& listings = m_listings[connection];
+    for(auto it = listings.begin(); it != listings.end();){
+        if(it->first.second)
+            it = listings.erase(it);
+        else
+            ++it;
+    }
+}
+
+void ListingCache::clear(const std::string &connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_version++;
+    m_listings.erase(connection);
+}
+
+ListingCacheStats ListingCache::get_stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ListingCacheStats stats = m_stats;
+    stats.entries = 0;
+    for(auto& it: m_listings)
+        stats.entries += it.second.size();
+
+    return stats;
+}
@@ -0,0 +1,95 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifndef CLOUD_STORAGE_LISTING_CACHE_H
+#define CLOUD_STORAGE_LISTING_CACHE_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "library.h"
+
+using namespace nlohmann;
+
+#define DEFAULT_LISTING_CACHE_TTL 60
+
+struct ListingCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t entries = 0;
+};
+
+// Folder listings by connection, path and trash flag.
+// Listing is put with the version taken before it was requested, so the listing
+// started before any invalidation is not cached.
+class ListingCache {
+public:
+    // returns false if there is no listing younger than ttl seconds
+    bool get(const std::string &connection, const std::string &path, BOOL isTrash, int ttl,
+             std::vector<WIN32_FIND_DATAW> &entries);
+
+    uint64_t get_version();
+
+    void put(const std::string &connection, const std::string &path, BOOL isTrash,
+             const std::vector<WIN32_FIND_DATAW> &entries, uint64_t version);
+
+    // listing saved in previous session, it is never returned by get
+    void restore(const std::string &connection, const std::string &path, BOOL isTrash,
+                 const std::vector<WIN32_FIND_DATAW> &entries);
+
+    // returns restored listing once, caller should revalidate it
+    bool take_restored(const std::string &connection, const std::string &path, BOOL isTrash,
+                       std::vector<WIN32_FIND_DATAW> &entries);
+
+    // restored listings become fresh, when changes since previous session are applied
+    void promote_restored(const std::string &connection);
+
+    // all listings of the connection, including restored ones
+    json get_listings(const std::string &connection);
+
+    // drop listings of the path, its parent folder and all subfolders
+    void invalidate(const std::string &connection, const std::string &path);
+
+    void invalidate_trash(const std::string &connection);
+
+    // drop all listings of the connection
+    void clear(const std::string &connection);
+
+    ListingCacheStats get_stats();
+
+private:
+    struct Listing {
+        std::vector<WIN32_FIND_DATAW> entries;
+        std::chrono::steady_clock::time_point time;
+        bool restored;
+    };
+
+    typedef std::pair<std::string, BOOL> Key;
+
+    std::mutex m_mutex;
+    std::map<std::string, std::map<Key, Listing>> m_listings;
+    uint64_t m_version = 0;
+    ListingCacheStats m_stats;
+};
+
+#endif //CLOUD_STORAGE_LISTING_CACHE_H
@@ -0,0 +1,203 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "metadata_store.h"
+#include "plugin_utils.h"
+
+void MetadataStore::open(const std::string &dirPath)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_dir_path = dirPath;
+    mkdir(m_dir_path.c_str(), 0755);
+}
+
+std::string MetadataStore::_get_file_path(const std::string &connection)
+{
+    // connection name may contain any characters
+    std::string name;
+    char buf[4];
+    for(unsigned char c: connection){
+        if(isalnum(c) || c == '-' || c == '_' || c == '.'){
+            name += c;
+        } else {
+            snprintf(buf, sizeof(buf), "%%%02X", c);
+            name += buf;
+        }
+    }
+
+    return m_dir_path + kPathSeparator + name + ".msgpack";
+}
+
+json MetadataStore::load(const std::string &connection)
+{
+    std::string path = _get_file_path(connection);
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return json();
+
+    struct stat buf;
+    if(fstat(fd, &buf) != 0 || buf.st_size == 0){
+        close(fd);
+        return json();
+    }
+
+    void* data = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return json();
+
+    json js;
+    try{
+        // parsed directly from the mapped pages
+        const uint8_t* begin = (const uint8_t*) data;
+        js = json::from_msgpack(begin, begin + buf.st_size);
+    } catch(json::exception& e){
+        // broken file is ignored and overwritten later
+        js = json();
+    }
+
+    munmap(data, buf.st_size);
+    return js;
+}
+
+void MetadataStore::save(const std::string &connection, const json &metadata)
+{
+    std::string path = _get_file_path(connection);
+    std::string tmpPath = path + ".tmp";
+
+    std::vector<uint8_t> data = json::to_msgpack(metadata);
+
+    std::ofstream ofs(tmpPath, std::ios::binary | std::ofstream::out | std::ios::trunc);
+    ofs.write((const char*) data.data(), data.size());
+    ofs.close();
+
+    if(!ofs.good() || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        std::remove(tmpPath.c_str());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_save_times[connection] = std::chrono::steady_clock::now();
+}
+
+void MetadataStore::remove(const std::string &connection)
+{
+    std::remove(_get_file_path(connection).c_str());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_save_times.erase(connection);
+    m_pending.erase(connection);
+}
+
+bool MetadataStore::is_save_due(const std::string &connection, int interval)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_save_times.find(connection);
+    return it == m_save_times.end() ||
+           std::chrono::steady_clock::now() - it->second > std::chrono::seconds(interval);
+}
+
+void MetadataStore::add_pending(const std::string &connection, const json &metadata)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    json& pending = m_pending[connection];
+    if(!pending.is_object())
+        pending = json::object();
+
+    // newer mappings replace the older ones
+    for(auto it = metadata.begin(); it != metadata.end(); ++it){
+        if(it.value().is_object() && pending[it.key()].is_object())
+            pending[it.key()].update(it.value());
+        else
+            pending[it.key()] = it.value();
+    }
+}
+
+json MetadataStore::take_pending(const std::string &connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pending.find(connection);
+    if(it == m_pending.end())
+        return json();
+
+    json pending = it->second;
+    m_pending.erase(it);
+    return pending;
+}
+
+static uint64_t filetime_to_uint64(const FILETIME &ft)
+{
+    return ((uint64_t) ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
+
+static FILETIME uint64_to_filetime(uint64_t value)
+{
+    FILETIME ft;
+    ft.dwLowDateTime = (DWORD) (value & 0xffffffff);
+    ft.dwHighDateTime = (DWORD) (value >> 32);
+    return ft;
+}
+
+json MetadataStore::entries_to_json(const std::vector<WIN32_FIND_DATAW> &entries)
+{
+    // [name, attributes, size, creation time, last write time]
+    json js = json::array();
+    for(auto& entry: entries){
+        js.push_back({
+            UTF16toUTF8(entry.cFileName),
+            entry.dwFileAttributes,
+            ((uint64_t) entry.nFileSizeHigh << 32) | entry.nFileSizeLow,
+            filetime_to_uint64(entry.ftCreationTime),
+            filetime_to_uint64(entry.ftLastWriteTime)
+        });
+    }
+
+    return js;
+}
+
+void MetadataStore::entries_from_json(const json &js, std::vector<WIN32_FIND_DATAW> &entries)
+{
+    entries.clear();
+    if(!js.is_array())
+        return;
+
+    entries.resize(js.size());
+    int i = 0;
+    for(auto& item: js){
+        WIN32_FIND_DATAW& entry = entries[i++];
+        memset(&entry, 0, sizeof(WIN32_FIND_DATAW));
+
+        wcharstring wName = UTF8toUTF16(item.at(0).get<std::string>());
+        size_t str_size = (MAX_PATH > wName.size()+1)? (wName.size()+1): MAX_PATH;
+        memcpy(entry.cFileName, wName.data(), sizeof(WCHAR) * str_size);
+
+        uint64_t size = item.at(2).get<uint64_t>();
+        entry.dwFileAttributes = item.at(1).get<DWORD>();
+        set_file_size(entry, size);
+        entry.ftCreationTime = uint64_to_filetime(item.at(3).get<uint64_t>());
+        entry.ftLastWriteTime = uint64_to_filetime(item.at(4).get<uint64_t>());
+    }
+}
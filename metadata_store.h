@@ -0,0 +1,69 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifndef CLOUD_STORAGE_METADATA_STORE_H
+#define CLOUD_STORAGE_METADATA_STORE_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "library.h"
+
+using namespace nlohmann;
+
+#define METADATA_SAVE_INTERVAL 10
+
+// Listings and path to ID mappings of every connection, kept between sessions
+// in <config dir>/cloud_storage_cache/<connection>.msgpack.
+// File is memory mapped and parsed once, saving is limited to one per interval.
+class MetadataStore {
+public:
+    void open(const std::string &dirPath);
+
+    // returns null if connection has no saved metadata
+    json load(const std::string &connection);
+
+    void save(const std::string &connection, const json &metadata);
+
+    void remove(const std::string &connection);
+
+    // true if metadata of connection was not saved during the last interval seconds
+    bool is_save_due(const std::string &connection, int interval = METADATA_SAVE_INTERVAL);
+
+    // client mappings waiting to be merged into the client on its thread
+    void add_pending(const std::string &connection, const json &metadata);
+    json take_pending(const std::string &connection);
+
+    static json entries_to_json(const std::vector<WIN32_FIND_DATAW> &entries);
+    static void entries_from_json(const json &js, std::vector<WIN32_FIND_DATAW> &entries);
+
+private:
+    std::mutex m_mutex;
+    std::string m_dir_path;
+    std::map<std::string, std::chrono::steady_clock::time_point> m_save_times;
+    std::map<std::string, json> m_pending;
+
+    std::string _get_file_path(const std::string &connection);
+};
+
+#endif //CLOUD_STORAGE_METADATA_STORE_H
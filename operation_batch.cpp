@@ -0,0 +1,127 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#include "operation_batch.h"
+
+void OperationBatch::begin()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_depth++;
+}
+
+bool OperationBatch::is_active()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_depth > 0;
+}
+
+std::vector<BatchOperation> OperationBatch::add(const std::string &connection, const BatchOperation &operation, size_t limit)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<BatchOperation>& operations = m_operations[connection];
+    operations.push_back(operation);
+
+    std::vector<BatchOperation> full;
+    if(operations.size() >= limit)
+        full.swap(operations);
+
+    return full;
+}
+
+std::vector<BatchOperation> OperationBatch::take(const std::string &connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<BatchOperation> operations;
+    auto it = m_operations.find(connection);
+    if(it != m_operations.end()){
+        operations.swap(it->second);
+        m_operations.erase(it);
+    }
+
+    return operations;
+}
+
+bool OperationBatch::is_target(const std::string &connection, const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_operations.find(connection);
+    if(it == m_operations.end())
+        return false;
+
+    for(auto& operation: it->second){
+        if(operation.to == path)
+            return true;
+    }
+
+    return false;
+}
+
+std::map<std::string, std::vector<BatchOperation>> OperationBatch::end()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<std::string, std::vector<BatchOperation>> operations;
+    if(m_depth > 0 && --m_depth == 0){
+        operations.swap(m_operations);
+        m_failed_sources.clear();
+    }
+
+    return operations;
+}
+
+void OperationBatch::add_failed_source(const std::string &connection, const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_failed_sources[connection].push_back(path);
+}
+
+bool OperationBatch::contains_failed_source(const std::string &connection, const std::string &folder)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_failed_sources.find(connection);
+    if(it == m_failed_sources.end())
+        return false;
+
+    for(auto& path: it->second){
+        if(ServiceClient::is_inside_path(folder, path))
+            return true;
+    }
+
+    return false;
+}
+
+void OperationBatch::add_errors(const std::vector<std::string> &errors)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_errors.insert(m_errors.end(), errors.begin(), errors.end());
+}
+
+std::vector<std::string> OperationBatch::take_errors()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<std::string> errors;
+    errors.swap(m_errors);
+    return errors;
+}
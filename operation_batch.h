@@ -0,0 +1,68 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifndef CLOUD_STORAGE_OPERATION_BATCH_H
+#define CLOUD_STORAGE_OPERATION_BATCH_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "service_clients/service_client.h"
+
+// Deletes, moves and copies of one multi-file operation, between FsStatusInfoW start and end.
+// Operations are collected by connection and sent as batches, DC gets success at once
+// and errors of failed operations are shown when operation ends.
+class OperationBatch {
+public:
+    // start of operation, calls can be nested
+    void begin();
+
+    bool is_active();
+
+    // returns operations to run now, when batch of the connection reached the limit
+    std::vector<BatchOperation> add(const std::string &connection, const BatchOperation &operation, size_t limit);
+
+    // collected operations of the connection, to run them before the one which depends on them
+    std::vector<BatchOperation> take(const std::string &connection);
+
+    // path is the target of collected move or copy
+    bool is_target(const std::string &connection, const std::string &path);
+
+    // end of the outermost operation returns all collected operations
+    std::map<std::string, std::vector<BatchOperation>> end();
+
+    // source of failed move or copy, folder which contains it is not deleted until operation ends
+    void add_failed_source(const std::string &connection, const std::string &path);
+    bool contains_failed_source(const std::string &connection, const std::string &folder);
+
+    void add_errors(const std::vector<std::string> &errors);
+
+    std::vector<std::string> take_errors();
+
+private:
+    std::mutex m_mutex;
+    int m_depth = 0;
+    std::map<std::string, std::vector<BatchOperation>> m_operations;
+    std::map<std::string, std::vector<std::string>> m_failed_sources;
+    std::vector<std::string> m_errors;
+};
+
+#endif //CLOUD_STORAGE_OPERATION_BATCH_H
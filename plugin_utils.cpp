@@ -73,6 +73,21 @@ BOOL file_exists(const std::string& filename)
     return stat(filename.c_str(), &buf) == 0;
 }
 
+int64_t get_file_size(const std::string& filename)
+{
+    struct stat buf;
+    if(stat(filename.c_str(), &buf) != 0)
+        return -1;
+
+    return buf.st_size;
+}
+
+void set_file_size(WIN32_FIND_DATAW &data, uint64_t size)
+{
+    data.nFileSizeHigh = (DWORD) (size >> 32);
+    data.nFileSizeLow = (DWORD) (size & 0xffffffff);
+}
+
 pResources prepare_connections(const nlohmann::json &connections)
 {
     pResources pRes = new tResources;
@@ -44,6 +44,11 @@ wcharstring UTF8toUTF16(const std::string &str);
 
 BOOL file_exists(const std::string &filename);
 
+int64_t get_file_size(const std::string &filename);
+
+// split 64-bit size to the low and high parts of find data
+void set_file_size(WIN32_FIND_DATAW &data, uint64_t size);
+
 void save_config(const std::string &path, const json &jsonConfig);
 
 std::string get_oauth_token(json& jsConfig, ServiceClient* client, int pluginNumber, tRequestProcW requestProc,
@@ -18,20 +18,28 @@ License along with this library; if not, write to the Free Software
         Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
 */
 
+#include <atomic>
+#include <thread>
 #include "dropbox_client.h"
+#include "segmented_download.h"
 #include "../plugin_utils.h"
 
 #define CHUNK_SIZE 150000000
+#define CONCURRENT_CHUNK_ALIGN (4 * 1024 * 1024)
 
 DropboxClient::DropboxClient()
 {
     m_http_client = new httplib::SSLClient("api.dropboxapi.com");
+    setup_http_client(*m_http_client);
+    m_content_client = new httplib::SSLClient("content.dropboxapi.com");
+    setup_http_client(*m_content_client);
     m_client_id = "ovy1encsqm627kl";
 }
 
 DropboxClient::~DropboxClient()
 {
     delete m_http_client;
+    delete m_content_client;
 }
 
 std::string DropboxClient::get_auth_page_url()
@@ -47,7 +55,7 @@ void DropboxClient::set_oauth_token(const char *token)
 
     std::string header_token = "Bearer ";
     header_token += token;
-    m_headers = { {"Authorization", header_token} };
+    _set_headers({ {"Authorization", header_token} });
 }
 
 void DropboxClient::throw_response_error(httplib::Response* resp){
@@ -77,7 +85,7 @@ pResources DropboxClient::get_resources(std::string path, BOOL isTrash)
             {"limit", 200}
     };
 
-    auto r = m_http_client->Post("/2/files/list_folder", m_headers, jsBody.dump(), "application/json");
+    auto r = m_http_client->Post("/2/files/list_folder", _get_headers(), jsBody.dump(), "application/json");
 
     if(r.get() && r->status==200){
         pResources pRes = new tResources;
@@ -90,7 +98,7 @@ pResources DropboxClient::get_resources(std::string path, BOOL isTrash)
             jsBody = {
                     {"cursor", js["cursor"].get<std::string>()}
             };
-            r = m_http_client->Post("/2/files/list_folder/continue", m_headers, jsBody.dump(), "application/json");
+            r = m_http_client->Post("/2/files/list_folder/continue", _get_headers(), jsBody.dump(), "application/json");
             if(!r.get() || r->status!=200)
                 throw_response_error(r.get());
 
@@ -122,8 +130,7 @@ void DropboxClient::prepare_folder_result(const json &js, pResources pRes, BOOL
 
         if(item[".tag"].get<std::string>() == "file") {
             file.dwFileAttributes = 0;
-            file.nFileSizeLow = (DWORD) item["size"].get<int>();
-            file.nFileSizeHigh = 0;
+            set_file_size(file, item["size"].get<uint64_t>());
             file.ftCreationTime = parse_iso_time(item["client_modified"].get<std::string>());
             file.ftLastWriteTime = parse_iso_time(item["server_modified"].get<std::string>());
         } else {
@@ -147,7 +154,7 @@ void DropboxClient::makeFolder(std::string utf8Path)
             {"autorename", true}
     };
 
-    auto r = m_http_client->Post("/2/files/create_folder_v2", m_headers, jsBody.dump(), "application/json");
+    auto r = m_http_client->Post("/2/files/create_folder_v2", _get_headers(), jsBody.dump(), "application/json");
 
     if(!r.get() || r->status!=200)
         throw_response_error(r.get());
@@ -157,59 +164,59 @@ void DropboxClient::removeResource(std::string utf8Path)
 {
     json jsBody = { {"path", utf8Path} };
 
-    auto r = m_http_client->Post("/2/files/delete_v2", m_headers, jsBody.dump(), "application/json");
+    auto r = m_http_client->Post("/2/files/delete_v2", _get_headers(), jsBody.dump(), "application/json");
 
     if(!r.get() || r->status!=200)
         throw_response_error(r.get());
 }
 
-void DropboxClient::downloadFile(std::string path, std::ofstream &ofstream, std::string localPath)
+void DropboxClient::downloadFile(std::string path, std::ofstream &ofstream, std::string localPath, uint64_t offset, TransferProgress* progress)
 {
-    httplib::SSLClient cli("content.dropboxapi.com");
     json jsParams = { {"path", path} };
 
-    httplib::Headers hd = m_headers;
+    httplib::Headers hd = _get_headers();
     hd.emplace("Dropbox-API-Arg", jsParams.dump());
-    std::string strEmpty;
+    hd.emplace("Content-Type", "text/plain");
 
-    auto r = cli.Post("/2/files/download", hd, strEmpty, "text/plain");
+    SegmentedDownload download("content.dropboxapi.com", 443, "/2/files/download", hd, "POST");
+    download.set_segments(m_download_segments);
+    download.set_segment_size(_get_download_segment_size());
+    download.set_progress(progress);
+    download.set_connection_pool(&m_connection_pool);
 
-    if(r.get() && r->status == 200){
-        ofstream.write(r->body.data(), r->body.size());
-    } else {
+    auto r = download.run(ofstream, localPath, offset);
+
+    if(!r.get() || (r->status != 200 && r->status != 206)){
         throw_response_error(r.get());
     }
 }
 
-void DropboxClient::uploadFile(std::string path, std::ifstream &ifstream, BOOL overwrite)
+void DropboxClient::uploadFile(std::string path, UploadSource &source, BOOL overwrite, BOOL resume)
 {
-    ifstream.seekg(0, ifstream.end);
-    int fileSize = ifstream.tellg();
-    ifstream.seekg(0, ifstream.beg);
+    int64_t fileSize = source.size();
 
-    if(fileSize < CHUNK_SIZE){ // use upload_session/start for files more than 150Mb
-        _upload_small_file(path, ifstream, overwrite);
+    // single request is limited by 150Mb, bigger files are sent in chunks of upload session
+    if(fileSize <= (int64_t) _get_concurrent_chunk_size() || (fileSize < CHUNK_SIZE && m_upload_concurrency < 2)){
+        _upload_small_file(path, source, overwrite, fileSize);
     } else {
-        _upload_big_file(path, ifstream, overwrite, fileSize);
+        _upload_big_file(path, source, overwrite, fileSize, resume);
     }
 }
 
-void DropboxClient::_upload_small_file(std::string& path, std::ifstream &ifstream, BOOL overwrite)
+void DropboxClient::_upload_small_file(std::string& path, UploadSource &source, BOOL overwrite, int64_t fileSize)
 {
-    httplib::SSLClient cli("content.dropboxapi.com");
     json jsParams = {
             {"path", path},
             {"mode", { {".tag", (overwrite? "overwrite": "add")} } },
             {"autorename", false}
     };
 
-    httplib::Headers hd = m_headers;
+    httplib::Headers hd = _get_headers();
     hd.emplace("Dropbox-API-Arg", jsParams.dump());
 
-    std::stringstream body;
-    body << ifstream.rdbuf();
-
-    auto r = cli.Post("/2/files/upload", hd, body.str(), "application/octet-stream");
+    auto r = m_content_client->Post("/2/files/upload", hd, fileSize, source.provider(0), "application/octet-stream");
+    if(source.is_cancelled())
+        throw transfer_cancelled_exception();
 
     if(r.get() && r->status == 200){
         return;
@@ -220,59 +227,168 @@ void DropboxClient::_upload_small_file(std::string& path, std::ifstream &ifstrea
     //TODO throw status 409 if file exists
 }
 
-void DropboxClient::_upload_big_file(std::string& path, std::ifstream &ifstream, BOOL overwrite, int fileSize)
+uint64_t DropboxClient::_get_concurrent_chunk_size()
+{
+    // chunks of concurrent session, except the last one, must be multiple of 4Mb
+    uint64_t size = _get_upload_chunk_size();
+    size -= size % CONCURRENT_CHUNK_ALIGN;
+
+    return std::min<uint64_t>(std::max<uint64_t>(size, CONCURRENT_CHUNK_ALIGN), CHUNK_SIZE - CHUNK_SIZE % CONCURRENT_CHUNK_ALIGN);
+}
+
+std::shared_ptr<httplib::Response> DropboxClient::_append_chunk(httplib::Client &cli, const std::string &session_id,
+                                                                UploadSource &source, int64_t offset, int64_t length, bool close)
 {
-    int count = fileSize / CHUNK_SIZE + ((fileSize % CHUNK_SIZE) > 0 ? 1 : 0);
+    json jsParams = {
+            {"cursor",
+                      { {"session_id", session_id}, {"offset", offset} }
+            },
+            {"close", close}
+    };
 
-    httplib::SSLClient cli("content.dropboxapi.com");
-    httplib::Headers hd = m_headers;
-    json jsParams = { {"close", false} };
+    httplib::Headers hd = _get_headers();
     hd.emplace("Dropbox-API-Arg", jsParams.dump());
 
-    int offset = 0;
-    std::string body;
-    body.reserve(CHUNK_SIZE);
-    body.resize(CHUNK_SIZE);
-    ifstream.read(&body[0], CHUNK_SIZE);
+    std::shared_ptr<httplib::Response> r;
+    for(int attempt = 1; attempt <= UPLOAD_CHUNK_RETRIES; attempt++){
+        r = cli.Post("/2/files/upload_session/append_v2", hd, length, source.provider(offset), "application/octet-stream");
 
-    auto r = cli.Post("/2/files/upload_session/start", hd, body, "application/octet-stream");
+        // connection errors, server errors and rate limits are temporary
+        if(source.is_cancelled() || (r.get() && r->status < 500 && r->status != 429))
+            break;
 
-    if(!r.get() || r->status!=200)
-        throw_response_error(r.get());
+        if(attempt < UPLOAD_CHUNK_RETRIES){
+            int delay = 1 << attempt;
+            if(r.get() && r->has_header("Retry-After"))
+                delay = std::atoi(r->get_header_value("Retry-After").c_str());
+            std::this_thread::sleep_for(std::chrono::seconds(delay));
+        }
+    }
+
+    return r;
+}
 
-    const auto js = json::parse(r->body);
-    std::string session_id = js["session_id"].get<std::string>();
-
-    int c = count - 2;
-    while(c > 0){
-        offset += CHUNK_SIZE;
-        c--;
-
-        jsParams = {
-                {"cursor",
-                          { {"session_id", session_id}, {"offset", offset} }
-                },
-                {"close", false}
-        };
-        hd.erase("Dropbox-API-Arg");
+void DropboxClient::_upload_big_file(std::string& path, UploadSource &source, BOOL overwrite, int64_t fileSize, BOOL resume)
+{
+    int64_t chunkSize = _get_concurrent_chunk_size();
+    int64_t count = (fileSize + chunkSize - 1) / chunkSize;
+
+    std::string session_id;
+    std::vector<char> done(count, false);
+
+    json session = resume ? _get_upload_session(path) : json();
+    if(session.is_object() && session["size"] == fileSize && session["chunk_size"] == chunkSize && session["done"].is_array()){
+        session_id = session["session_id"].get<std::string>();
+        for(auto& index: session["done"])
+            if(index.is_number() && index >= 0 && index < count)
+                done[index.get<int64_t>()] = true;
+    }
+
+    if(session_id.empty()){
+        json jsParams = { {"close", false}, {"session_type", { {".tag", "concurrent"} } } };
+        httplib::Headers hd = _get_headers();
         hd.emplace("Dropbox-API-Arg", jsParams.dump());
-        ifstream.read(&body[0], CHUNK_SIZE);
-        r = cli.Post("/2/files/upload_session/append_v2", hd, body, "application/octet-stream");
 
-        if(!r.get() || r->status!=200){
-            // 409 is reserved for file exists error
-            if(r->status == 409)
-                r->status = 500;
+        std::string empty;
+        auto r = m_content_client->Post("/2/files/upload_session/start", hd, empty, "application/octet-stream");
+
+        if(!r.get() || r->status!=200)
             throw_response_error(r.get());
+
+        const auto js = json::parse(r->body);
+        session_id = js["session_id"].get<std::string>();
+        _save_upload_session(path, { {"session_id", session_id}, {"size", fileSize}, {"chunk_size", chunkSize}, {"done", json::array()} });
+    }
+
+    // last chunk closes the session, so it is sent after all others
+    std::vector<int64_t> pending;
+    for(int64_t i=0; i<count-1; i++)
+        if(!done[i])
+            pending.push_back(i);
+
+    if(source.get_progress())
+        source.get_progress()->set_done((count - 1 - pending.size()) * chunkSize);
+
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::atomic<int> finished(0);
+    std::mutex mutex;
+    std::shared_ptr<httplib::Response> error;
+
+    auto worker = [&]() {
+        httplib::SSLClient cli("content.dropboxapi.com");
+        setup_http_client(cli);
+
+        while(!failed && !source.is_cancelled()){
+            size_t i = next++;
+            if(i >= pending.size())
+                break;
+
+            int64_t index = pending[i];
+            auto r = _append_chunk(cli, session_id, source, index * chunkSize, chunkSize, false);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!r.get() || r->status != 200){
+                if(!failed)
+                    error = r;
+                failed = true;
+                break;
+            }
+
+            done[index] = true;
+            json jsDone = json::array();
+            for(int64_t k=0; k<count; k++)
+                if(done[k])
+                    jsDone.push_back(k);
+            _save_upload_session(path, { {"session_id", session_id}, {"size", fileSize}, {"chunk_size", chunkSize}, {"done", jsDone} });
         }
 
-        //TODO check incorrect_offset error - to restart from correct one, status = 409
+        finished++;
+    };
+
+    int workers_count = (int) std::min<size_t>(std::max(m_upload_concurrency, 1), pending.size());
+
+    std::vector<std::thread> workers;
+    for(int i=0; i<workers_count; i++)
+        workers.emplace_back(worker);
+
+    // progress is reported from this thread only
+    while(finished < workers_count){
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if(source.get_progress())
+            source.get_progress()->report();
     }
 
-    offset += CHUNK_SIZE;
-    jsParams = {
+    for(auto& t: workers)
+        t.join();
+
+    std::shared_ptr<httplib::Response> r;
+    if(!failed && !source.is_cancelled())
+        r = _append_chunk(*m_content_client, session_id, source, (count - 1) * chunkSize, fileSize - (count - 1) * chunkSize, true);
+    else
+        r = error;
+
+    // Dropbox has no call to remove session, it expires by itself
+    if(source.is_cancelled()){
+        _remove_upload_session(path);
+        throw transfer_cancelled_exception();
+    }
+
+    if(!r.get() || r->status != 200){
+        if(r.get() && r->status == 409){
+            // session is not found or closed, it cannot be resumed anymore
+            _remove_upload_session(path);
+
+            // 409 is reserved for file exists error
+            r->status = 500;
+        }
+
+        throw_response_error(r.get());
+    }
+
+    json jsParams = {
             {"cursor",
-                      { {"session_id", session_id}, {"offset", offset} }
+                      { {"session_id", session_id}, {"offset", fileSize} }
             },
             {"commit",
                     {
@@ -282,13 +398,14 @@ void DropboxClient::_upload_big_file(std::string& path, std::ifstream &ifstream,
                     }
             }
     };
-    hd.erase("Dropbox-API-Arg");
+    httplib::Headers hd = _get_headers();
     hd.emplace("Dropbox-API-Arg", jsParams.dump());
-    body.resize(fileSize - offset);
-    ifstream.read(&body[0], fileSize - offset);
-    r = cli.Post("/2/files/upload_session/finish", hd, body, "application/octet-stream");
+
+    std::string empty;
+    r = m_content_client->Post("/2/files/upload_session/finish", hd, empty, "application/octet-stream");
 
     if(r.get() && r->status == 200){
+        _remove_upload_session(path);
         return;
     } else {
         throw_response_error(r.get());
@@ -304,7 +421,7 @@ void DropboxClient::move(std::string from, std::string to, BOOL overwrite)
             {"autorename", false}
     };
 
-    auto r = m_http_client->Post("/2/files/move_v2", m_headers, jsBody.dump(), "application/json");
+    auto r = m_http_client->Post("/2/files/move_v2", _get_headers(), jsBody.dump(), "application/json");
 
     if(!r.get() || r->status!=200)
         throw_response_error(r.get());
@@ -318,12 +435,132 @@ void DropboxClient::copy(std::string from, std::string to, BOOL overwrite)
             {"autorename", false}
     };
 
-    auto r = m_http_client->Post("/2/files/copy_v2", m_headers, jsBody.dump(), "application/json");
+    auto r = m_http_client->Post("/2/files/copy_v2", _get_headers(), jsBody.dump(), "application/json");
 
     if(!r.get() || r->status!=200)
         throw_response_error(r.get());
 }
 
+void DropboxClient::run_batch(std::vector<BatchOperation>& operations)
+{
+    // one request takes entries of one type, consecutive requests keep the order
+    size_t start = 0;
+    while(start < operations.size()){
+        size_t end = start + 1;
+        while(end < operations.size() && end - start < DROPBOX_BATCH_LIMIT && operations[end].type == operations[start].type)
+            end++;
+
+        // results of previous requests are known here
+        _skip_deletes(operations, start, end);
+
+        try{
+            _run_batch(operations, start, end);
+        } catch (std::exception & e){
+            for(size_t i=start; i<end; i++){
+                if(operations[i].error.empty())
+                    operations[i].error = e.what();
+            }
+        }
+
+        start = end;
+    }
+}
+
+void DropboxClient::_run_batch(std::vector<BatchOperation>& operations, size_t start, size_t end)
+{
+    const std::string& type = operations[start].type;
+    std::string url, checkUrl;
+    json entries = json::array();
+    json jsBody;
+
+    // skipped operations are not sent
+    std::vector<size_t> sent;
+    for(size_t i=start; i<end; i++){
+        if(operations[i].error.empty())
+            sent.push_back(i);
+    }
+    if(sent.empty())
+        return;
+
+    if(type == "delete"){
+        url = "/2/files/delete_batch";
+        checkUrl = "/2/files/delete_batch/check";
+        for(size_t i: sent)
+            entries.push_back({ {"path", operations[i].from} });
+    } else if(type == "move" || type == "copy"){
+        url = (type == "move") ? "/2/files/move_batch_v2" : "/2/files/copy_batch_v2";
+        checkUrl = (type == "move") ? "/2/files/move_batch/check_v2" : "/2/files/copy_batch/check_v2";
+        for(size_t i: sent)
+            entries.push_back({ {"from_path", operations[i].from}, {"to_path", operations[i].to} });
+        jsBody["autorename"] = false;
+    } else {
+        throw std::runtime_error("Unknown batch operation: " + type);
+    }
+    jsBody["entries"] = entries;
+
+    auto r = m_http_client->Post(url.c_str(), _get_headers(), jsBody.dump(), "application/json");
+    if(!r.get() || r->status!=200)
+        throw_response_error(r.get());
+
+    json js = json::parse(r->body);
+    if(js[".tag"] == "async_job_id")
+        js = _wait_batch_job(checkUrl, js["async_job_id"].get<std::string>());
+
+    if(js[".tag"] != "complete")
+        throw service_client_exception(500, "Batch operation error: " + _get_error_tag(js));
+
+    json& results = js["entries"];
+    for(size_t i=0; i<sent.size(); i++){
+        // entry without result is not known to be done
+        if(i >= results.size()){
+            operations[sent[i]].error = "Unknown error";
+            continue;
+        }
+
+        if(results[i][".tag"] != "failure")
+            continue;
+
+        std::string error = _get_error_tag(results[i]["failure"]);
+
+        // already deleted, i.e. together with its folder
+        if(type == "delete" && error.find("not_found") != std::string::npos)
+            continue;
+
+        operations[sent[i]].error = error;
+    }
+}
+
+json DropboxClient::_wait_batch_job(const std::string& checkUrl, const std::string& jobId)
+{
+    json js_async = { {"async_job_id", jobId} };
+
+    return get_operation_poller().add([this, checkUrl, js_async](json& result){
+        auto r = m_http_client->Post(checkUrl.c_str(), _get_headers(), js_async.dump(), "application/json");
+        if(!r.get() || r->status!=200)
+            throw_response_error(r.get());
+
+        result = json::parse(r->body);
+        return result[".tag"] != "in_progress";
+    }, DROPBOX_OPERATION_TIMEOUT).get();
+}
+
+std::string DropboxClient::_get_error_tag(const json& error)
+{
+    std::string result;
+    const json* current = &error;
+    while(current->is_object() && current->find(".tag") != current->end() && current->at(".tag").is_string()){
+        std::string tag = current->at(".tag").get<std::string>();
+        result += result.empty() ? tag : "/" + tag;
+
+        auto it = current->find(tag);
+        if(it == current->end())
+            break;
+        current = &(*it);
+    }
+
+    return result.empty() ? error.dump() : result;
+}
+
 void DropboxClient::saveFromUrl(std::string urlFrom, std::string pathTo)
 {
     json jsBody = {
@@ -331,41 +568,31 @@ void DropboxClient::saveFromUrl(std::string urlFrom, std::string pathTo)
             {"url", urlFrom}
     };
 
-    auto r = m_http_client->Post("/2/files/save_url", m_headers, jsBody.dump(), "application/json");
+    auto r = m_http_client->Post("/2/files/save_url", _get_headers(), jsBody.dump(), "application/json");
     if(!r.get() || r->status!=200)
         throw_response_error(r.get());
 
     json js = json::parse(r->body);
     if(js["async_job_id"].is_string()){
         json js_async = { {"async_job_id", js["async_job_id"].get<std::string>()} };
-        BOOL success = false;
-        int waitCount = 0;
-        do{
-            std::this_thread::sleep_for(std::chrono::seconds(2));
-            auto r2 = m_http_client->Post("/2/files/save_url/check_job_status", m_headers, js_async.dump(), "application/json");
+
+        get_operation_poller().add([this, js_async](json& result){
+            auto r2 = m_http_client->Post("/2/files/save_url/check_job_status", _get_headers(), js_async.dump(), "application/json");
             if(!r2.get() || r2->status!=200)
                 throw std::runtime_error("Error getting operation status");
 
-            json js2 = json::parse(r2->body);
-            if(js2[".tag"].is_string() && js2[".tag"].get<std::string>()=="complete")
-                success = true;
-
-            if(js2["error"].is_string())
+            result = json::parse(r2->body);
+            if(result["error"].is_string() || result[".tag"] == "failed")
                 throw service_client_exception(500, "Operation error");
 
-            // if(json2[".tag"].string_value() == "in_progress") - Do nothing, just wait
-            waitCount++;
-
-        } while(success==false && waitCount<30*5); //wait at least 5 min
-
-        if(success==false && waitCount>=30*5)
-            throw std::runtime_error("Operation is too long");
+            // "in_progress" - check again later
+            return result[".tag"] == "complete";
+        }, DROPBOX_OPERATION_TIMEOUT).get();
     }
 }
 
 void DropboxClient::downloadZip(std::string pathFrom, std::string pathTo)
 {
-    httplib::SSLClient cli("content.dropboxapi.com");
     pathFrom.erase(--pathFrom.end()); // remove last slash
     json jsParams = { {"path", pathFrom} };
 
@@ -377,20 +604,62 @@ void DropboxClient::downloadZip(std::string pathFrom, std::string pathTo)
     if(!ofs || ofs.bad())
         throw std::runtime_error("File create error");
 
-    httplib::Headers hd = m_headers;
+    httplib::Headers hd = _get_headers();
     hd.emplace("Dropbox-API-Arg", jsParams.dump());
     std::string strEmpty;
 
-    auto r = cli.Post("/2/files/download_zip", hd, strEmpty, "text/plain");
+    auto r = m_content_client->Post("/2/files/download_zip", hd, strEmpty, "text/plain", [&ofs](const char* data, size_t data_length){
+        ofs.write(data, data_length);
+        return ofs.good();
+    });
 
     if(r.get() && r->status == 200){
-        ofs.write(r->body.data(), r->body.size());
         ofs.close();
     } else {
         throw_response_error(r.get());
     }
 }
 
+json DropboxClient::get_changes(const std::string &cursor)
+{
+    if(cursor.empty()){
+        json jsBody = { {"path", ""}, {"recursive", true}, {"include_deleted", true} };
+        auto r = m_http_client->Post("/2/files/list_folder/get_latest_cursor", _get_headers(), jsBody.dump(), "application/json");
+        if(!r.get() || r->status != 200)
+            throw_response_error(r.get());
+
+        json js = json::parse(r->body);
+        return { {"cursor", js["cursor"]}, {"paths", json::array()} };
+    }
+
+    json result = { {"paths", json::array()} };
+    json jsBody = { {"cursor", cursor} };
+
+    while(true){
+        auto r = m_http_client->Post("/2/files/list_folder/continue", _get_headers(), jsBody.dump(), "application/json");
+        if(r.get() && r->status == 409){ // cursor is reset
+            json js = get_changes("");
+            js["reset"] = true;
+            return js;
+        }
+
+        if(!r.get() || r->status != 200)
+            throw_response_error(r.get());
+
+        json js = json::parse(r->body);
+        for(auto& entry: js["entries"]){
+            if(entry["path_display"].is_string())
+                result["paths"].push_back(entry["path_display"]);
+        }
+
+        jsBody = { {"cursor", js["cursor"]} };
+        if(!js["has_more"].is_boolean() || !js["has_more"].get<bool>()){
+            result["cursor"] = js["cursor"];
+            return result;
+        }
+    }
+}
+
 void DropboxClient::run_command(std::string remoteName, std::vector<std::string> &arguments)
 {
     if(arguments[0] == "download"){
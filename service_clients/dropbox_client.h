@@ -26,6 +26,11 @@ License along with this library; if not, write to the Free Software
 #include "httplib.h"
 #include "../library.h"
 
+// max entries of delete_batch, move_batch_v2 and copy_batch_v2
+#define DROPBOX_BATCH_LIMIT 1000
+// seconds to wait for batch job or save_url
+#define DROPBOX_OPERATION_TIMEOUT 300
+
 class DropboxClient: public ServiceClient {
 public:
     DropboxClient();
@@ -45,9 +50,9 @@ public:
 
     void removeResource(std::string utf8Path);
 
-    void downloadFile(std::string path, std::ofstream &ofstream, std::string localPath);
+    void downloadFile(std::string path, std::ofstream &ofstream, std::string localPath, uint64_t offset, TransferProgress* progress);
 
-    void uploadFile(std::string path, std::ifstream &ifstream, BOOL overwrite);
+    void uploadFile(std::string path, UploadSource &source, BOOL overwrite, BOOL resume);
 
     void move(std::string from, std::string to, BOOL overwrite);
 
@@ -63,18 +68,33 @@ public:
 
     void run_command(std::string remoteName, std::vector<std::string> &arguments);
 
+    json get_changes(const std::string& cursor);
+
+    size_t get_batch_limit() { return DROPBOX_BATCH_LIMIT; }
+
+    void run_batch(std::vector<BatchOperation>& operations);
+
 private:
     std::string token;
     httplib::SSLClient* m_http_client;
-    httplib::Headers m_headers;
+    httplib::SSLClient* m_content_client;
 
     void throw_response_error(httplib::Response* resp);
     void prepare_folder_result(const json &json, pResources pRes, BOOL isRoot);
 
-    void _upload_small_file(std::string& path, std::ifstream &ifstream, BOOL overwrite);
-    void _upload_big_file(std::string& path, std::ifstream &ifstream, BOOL overwrite, int fileSize);
+    void _upload_small_file(std::string& path, UploadSource &source, BOOL overwrite, int64_t fileSize);
+    void _upload_big_file(std::string& path, UploadSource &source, BOOL overwrite, int64_t fileSize, BOOL resume);
+    uint64_t _get_concurrent_chunk_size();
+    std::shared_ptr<httplib::Response> _append_chunk(httplib::Client& cli, const std::string& session_id,
+                                                     UploadSource &source, int64_t offset, int64_t length, bool close);
 
     void downloadZip(std::string pathFrom, std::string pathTo);
+
+    // entries from start to end have the same type
+    void _run_batch(std::vector<BatchOperation>& operations, size_t start, size_t end);
+    json _wait_batch_job(const std::string& checkUrl, const std::string& jobId);
+    // nested error tags joined by slash, i.e. "path_lookup/not_found"
+    std::string _get_error_tag(const json& error);
 };
 
 
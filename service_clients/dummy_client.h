@@ -43,9 +43,9 @@ public:
 
     void removeResource(std::string utf8Path) {}
 
-    void downloadFile(std::string path, std::ofstream &ofstream, std::string localPath) {}
+    void downloadFile(std::string path, std::ofstream &ofstream, std::string localPath, uint64_t offset, TransferProgress* progress) {}
 
-    void uploadFile(std::string path, std::ifstream &ifstream, BOOL overwrite) {}
+    void uploadFile(std::string path, UploadSource &source, BOOL overwrite, BOOL resume) {}
 
     void move(std::string from, std::string to, BOOL overwrite) {}
 
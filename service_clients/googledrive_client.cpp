@@ -18,10 +18,20 @@ License along with this library; if not, write to the Free Software
         Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
 */
 
+#include <random>
 #include <regex>
 #include "googledrive_client.h"
+#include "segmented_download.h"
 #include "../plugin_utils.h"
 
+#define UPLOAD_CHUNK_ALIGN (256 * 1024)
+#define UPLOAD_RETRIES 8
+#define UPLOAD_MAX_BACKOFF 64 // seconds
+
+// results of upload status query besides received size
+#define UPLOAD_OFFSET_EXPIRED -1
+#define UPLOAD_OFFSET_UNKNOWN -2
+
 const char* exportDlg = R"(
 object dialogBox: TDialogBox
   Left = 2200
@@ -119,14 +129,18 @@ std::map<std::string, std::vector<mimeType> > export_types {
         }
 };
 
-std::string g_path;
+// mime type chosen in export dialog, dialog procedure has no user data,
+// so dialogs of concurrent downloads are shown one by one
+std::string g_export_type;
+std::mutex g_export_mutex;
 
 extern std::unique_ptr<tExtensionStartupInfo> gExtensionInfoPtr;
 
 GoogleDriveClient::GoogleDriveClient()
 {
     m_http_client = new httplib::SSLClient("www.googleapis.com");
-    m_resourceNamesMap["/"] = "root";
+    setup_http_client(*m_http_client);
+    m_resourceNamesMap.put("/", "root");
     m_client_id = "1019190623375-06j9q3kgqnborccd85fudtf0f7rk7138.apps.googleusercontent.com";
 }
 
@@ -167,45 +181,99 @@ void GoogleDriveClient::set_oauth_token(const char *token)
 
     std::string header_token = "Bearer ";
     header_token += token;
-    m_headers = { {"Authorization", header_token}, {"Accept", "application/json"} };
+    _set_headers({ {"Authorization", header_token}, {"Accept", "application/json"} });
 }
 
 pResources GoogleDriveClient::get_resources(std::string path, BOOL isTrash)
 {
     std::string folderId("root"), folderName;
-    if (m_resourceNamesMap.find(path) != m_resourceNamesMap.end())
-        folderId = m_resourceNamesMap[path];
+    m_resourceNamesMap.get(path, folderId);
 
     std::string url = "/drive/v3/files?q=trashed=";
     url += (isTrash? "true": "false");
     url += " and '";
     url += folderId;
-    url += "' in parents&fields=files(id,name,size,createdTime,modifiedTime,parents,mimeType)";
-
-    auto r = m_http_client->Get(url.c_str(), m_headers);
+    url += "' in parents&pageSize=1000&fields=nextPageToken,files(id,name,size,createdTime,modifiedTime,parents,mimeType)";
 
-    if(r.get() && r->status==200){
-        const auto js = json::parse(r->body);
+    auto r = m_http_client->Get(url.c_str(), _get_headers());
 
-        return prepare_folder_result(js, path);
-    } else {
+    if(!r.get() || r->status!=200)
         throw_response_error(r.get());
+
+    json js = json::parse(r->body);
+    pResources pRes = prepare_folder_result(js, path);
+
+    if(js["nextPageToken"].is_string()){
+        // first page is shown while the rest are downloaded one by one
+        auto page = std::make_shared<std::future<std::shared_ptr<httplib::Response>>>(
+                _get_page_async(url + "&pageToken=" + url_encode(js["nextPageToken"].get<std::string>())));
+
+        pRes->next_page = [this, page, url, path](pResources pRes) {
+            while(page->valid()){
+                auto r = page->get();
+                if(!r.get() || r->status!=200)
+                    throw_response_error(r.get());
+
+                json js = json::parse(r->body);
+                if(js["nextPageToken"].is_string())
+                    *page = _get_page_async(url + "&pageToken=" + url_encode(js["nextPageToken"].get<std::string>()));
+
+                // page can be empty even if it is not the last one
+                size_t count = pRes->resource_array.size();
+                std::string folderPath = path;
+                _add_folder_items(js, pRes, folderPath);
+                if(pRes->resource_array.size() > count)
+                    return true;
+            }
+
+            return false;
+        };
     }
+
+    return pRes;
 }
 
-pResources GoogleDriveClient::prepare_folder_result(json js, std::string &path)
+std::future<std::shared_ptr<httplib::Response>> GoogleDriveClient::_get_page_async(const std::string &url)
 {
-    if(!js["files"].is_array())
-        throw std::runtime_error("Wrong Json format");
+    httplib::Headers headers = _get_headers();
+    httplib::ConnectionPool* pool = &m_connection_pool;
+
+    return std::async(std::launch::async, [url, headers, pool](){
+        httplib::SSLClient cli("www.googleapis.com");
+        setup_http_client(cli, pool);
+        return cli.Get(url.c_str(), headers);
+    });
+}
 
+pResources GoogleDriveClient::prepare_folder_result(json js, std::string &path)
+{
     BOOL isRoot = (path == "/");
-    int total = js["files"].size();
 
     pResources pRes = new tResources;
     pRes->nCount = 0;
-    pRes->resource_array.resize(isRoot ? total+1: total);
+    _add_folder_items(js, pRes, path);
+
+    if(isRoot){
+        WIN32_FIND_DATAW trash;
+        memset(&trash, 0, sizeof(WIN32_FIND_DATAW));
+        memcpy(trash.cFileName, u".Trash", sizeof(WCHAR) * 7);
+        trash.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+        trash.ftCreationTime = get_now_time();
+        trash.ftLastWriteTime = get_now_time();
+        pRes->resource_array.push_back(trash);
+    }
+
+    return pRes;
+}
+
+void GoogleDriveClient::_add_folder_items(json &js, pResources pRes, std::string &path)
+{
+    if(!js["files"].is_array())
+        throw std::runtime_error("Wrong Json format");
+
+    int i = pRes->resource_array.size();
+    pRes->resource_array.resize(i + js["files"].size());
 
-    int i=0;
     for(auto& item: js["files"]){
         wcharstring wName = UTF8toUTF16(item["name"].get<std::string>());
 
@@ -221,10 +289,9 @@ pResources GoogleDriveClient::prepare_folder_result(json js, std::string &path)
         } else {
             pRes->resource_array[i].dwFileAttributes = 0;
             if(item["size"].is_string())
-                pRes->resource_array[i].nFileSizeLow = (DWORD) std::stoi(item["size"].get<std::string>());
+                set_file_size(pRes->resource_array[i], std::stoull(item["size"].get<std::string>()));
             else
-                pRes->resource_array[i].nFileSizeLow = (DWORD) 0;
-            pRes->resource_array[i].nFileSizeHigh = 0;
+                set_file_size(pRes->resource_array[i], 0);
             pRes->resource_array[i].ftCreationTime = parse_iso_time(item["createdTime"].get<std::string>());
             pRes->resource_array[i].ftLastWriteTime = parse_iso_time(item["modifiedTime"].get<std::string>());
         }
@@ -233,22 +300,11 @@ pResources GoogleDriveClient::prepare_folder_result(json js, std::string &path)
         if(path != "/")
             p += "/";
         p += item["name"].get<std::string>();
-        m_resourceNamesMap[p] = item["id"].get<std::string>();
-        m_mimetypesMap[p] = item["mimeType"].get<std::string>();
+        m_resourceNamesMap.put(p, item["id"].get<std::string>());
+        m_mimetypesMap.put(p, item["mimeType"].get<std::string>());
 
         i++;
     }
-
-    if(isRoot){
-        memcpy(pRes->resource_array[total].cFileName, u".Trash", sizeof(WCHAR) * 7);
-        pRes->resource_array[total].dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
-        pRes->resource_array[total].nFileSizeLow = 0;
-        pRes->resource_array[total].nFileSizeHigh = 0;
-        pRes->resource_array[total].ftCreationTime = get_now_time();
-        pRes->resource_array[total].ftLastWriteTime = get_now_time();
-    }
-
-    return pRes;
 }
 
 void GoogleDriveClient::makeFolder(std::string utf8Path)
@@ -258,8 +314,7 @@ void GoogleDriveClient::makeFolder(std::string utf8Path)
     folderName = utf8Path.substr(p + 1);
     if(p>0){
         std::string parentFolderPath = utf8Path.substr(0, p);
-        if(m_resourceNamesMap.find(parentFolderPath) != m_resourceNamesMap.end())
-            parentFolderId = m_resourceNamesMap[parentFolderPath];
+        m_resourceNamesMap.get(parentFolderPath, parentFolderId);
     }
 
     json jsBody = {
@@ -268,14 +323,14 @@ void GoogleDriveClient::makeFolder(std::string utf8Path)
             {"parents", {parentFolderId}}
     };
 
-    httplib::Headers hd = m_headers;
+    httplib::Headers hd = _get_headers();
     hd.emplace("Content-Type", "application/json");
 
-    auto r = m_http_client->Post("/drive/v3/files", m_headers, jsBody.dump(), "application/json");
+    auto r = m_http_client->Post("/drive/v3/files", _get_headers(), jsBody.dump(), "application/json");
 
     if(r.get() && r->status==200){
         json js = json::parse(r->body);
-        m_resourceNamesMap[utf8Path] = js["id"].get<std::string>();
+        m_resourceNamesMap.put(utf8Path, js["id"].get<std::string>());
     } else {
         throw_response_error(r.get());
     }
@@ -283,12 +338,12 @@ void GoogleDriveClient::makeFolder(std::string utf8Path)
 
 void GoogleDriveClient::removeResource(std::string utf8Path)
 {
-    if(m_resourceNamesMap.find(utf8Path) == m_resourceNamesMap.end())
+    if(!m_resourceNamesMap.contains(utf8Path))
         throw std::runtime_error("resource ID not found");
 
     std::string url("/drive/v3/files/");
-    url += m_resourceNamesMap[utf8Path];
-    auto r = m_http_client->Delete(url.c_str(), m_headers);
+    url += m_resourceNamesMap.get(utf8Path);
+    auto r = m_http_client->Delete(url.c_str(), _get_headers());
 
     if(!r.get() || r->status!=204){
         throw_response_error(r.get());
@@ -301,7 +356,7 @@ intptr_t DlgProcExport(uintptr_t pDlg, char *DlgItemName, intptr_t Msg, intptr_t
     switch (Msg){
 
         case DN_INITDIALOG:
-            it = export_types.find(g_path);
+            it = export_types.find(g_export_type);
 
             for(mimeType& mt: it->second)
                 gExtensionInfoPtr->SendDlgMsg(pDlg, "cmbOptions", DM_LISTADD, (intptr_t)mt.name.c_str(), (intptr_t)mt.mType.c_str());
@@ -312,7 +367,7 @@ intptr_t DlgProcExport(uintptr_t pDlg, char *DlgItemName, intptr_t Msg, intptr_t
             if(strcmp(DlgItemName, "btnOK")==0){
                 int current = (int)gExtensionInfoPtr->SendDlgMsg(pDlg, "cmbOptions", DM_LISTGETITEMINDEX, 0, 0);
                 char *mime = (char*)gExtensionInfoPtr->SendDlgMsg(pDlg, "cmbOptions", DM_LISTGETDATA, current, 0);
-                g_path = mime;
+                g_export_type = mime;
 
                 gExtensionInfoPtr->SendDlgMsg(pDlg, DlgItemName, DM_CLOSE, 1, 0);
             } else if(strcmp(DlgItemName, "btnCancel")==0){
@@ -325,39 +380,69 @@ intptr_t DlgProcExport(uintptr_t pDlg, char *DlgItemName, intptr_t Msg, intptr_t
     return 0;
 }
 
-void GoogleDriveClient::downloadFile(std::string path, std::ofstream &ofstream, std::string localPath)
+void GoogleDriveClient::downloadFile(std::string path, std::ofstream &ofstream, std::string localPath, uint64_t offset, TransferProgress* progress)
 {
-    if(m_resourceNamesMap.find(path) == m_resourceNamesMap.end())
+    if(!m_resourceNamesMap.contains(path))
         throw std::runtime_error("resource ID not found");
 
-    auto it = export_types.find(m_mimetypesMap[path]);
+    auto it = export_types.find(m_mimetypesMap.get(path));
     bool exportedType = (it != export_types.end() );
 
     std::string newExtension;
     std::string url("/drive/v3/files/");
-    url += m_resourceNamesMap[path];
+    url += m_resourceNamesMap.get(path);
 
     if(exportedType){
+        if(offset > 0)
+            throw std::runtime_error("Resume is not supported for exported documents");
+
         url += "/export";
         if(gExtensionInfoPtr){
-            g_path = m_mimetypesMap[path];
+            std::lock_guard<std::mutex> lock(g_export_mutex);
+            g_export_type = m_mimetypesMap.get(path);
             BOOL res = gExtensionInfoPtr->DialogBoxLFM((intptr_t)exportDlg, strlen(exportDlg), DlgProcExport);
             if(!res)
                 throw std::runtime_error("Cancel export");
 
-            url += "?mimeType=" + g_path;
+            url += "?mimeType=" + g_export_type;
             for(mimeType& mt: it->second)
-                if(mt.mType == g_path)
+                if(mt.mType == g_export_type)
                     newExtension = mt.extension;
         }
     } else {
         url += "?alt=media";
+
+        SegmentedDownload download("www.googleapis.com", 443, url, _get_headers());
+        download.set_segments(m_download_segments);
+        download.set_segment_size(_get_download_segment_size());
+        download.set_progress(progress);
+        download.set_connection_pool(&m_connection_pool);
+
+        auto r = download.run(ofstream, localPath, offset);
+        if(!r.get() || (r->status != 200 && r->status != 206))
+            throw_response_error(r.get());
+
+        return;
     }
 
-    auto r = m_http_client->Get(url.c_str(), m_headers);
+    auto r = m_http_client->Get(url.c_str(), _get_headers(), [&ofstream, progress](const char* data, size_t data_length){
+        ofstream.write(data, data_length);
+        if(!ofstream.good())
+            return false;
+
+        // exported document has no known size
+        if(progress){
+            progress->add(data_length);
+            return progress->report();
+        }
+
+        return true;
+    });
+
+    if(progress)
+        progress->check_cancelled();
 
     if(r.get() && r->status == 200){
-        ofstream.write(r->body.data(), r->body.size());
         if(!newExtension.empty()){
             ofstream.close();
             std::string newName = localPath + "." + newExtension;
@@ -368,15 +453,151 @@ void GoogleDriveClient::downloadFile(std::string path, std::ofstream &ofstream,
     }
 }
 
-void GoogleDriveClient::uploadFile(std::string path, std::ifstream &ifstream, BOOL overwrite)
+void GoogleDriveClient::uploadFile(std::string path, UploadSource &source, BOOL overwrite, BOOL resume)
+{
+    int64_t fileSize = source.size();
+
+    std::string uploadUrl;
+    int64_t offset = 0;
+
+    json session = resume ? _get_upload_session(path) : json();
+    if(session.is_object() && session["size"] == fileSize){
+        uploadUrl = session["url"].get<std::string>();
+        offset = _get_upload_offset(uploadUrl, fileSize);
+        for(int attempt=1; offset == UPLOAD_OFFSET_UNKNOWN; attempt++){
+            if(attempt > UPLOAD_RETRIES)
+                throw std::runtime_error("Error getting upload status");
+
+            _backoff(attempt);
+            offset = _get_upload_offset(uploadUrl, fileSize);
+        }
+
+        if(offset >= fileSize){
+            _remove_upload_session(path);
+            return;
+        }
+
+        if(offset == UPLOAD_OFFSET_EXPIRED) // start new session
+            uploadUrl.clear();
+    }
+
+    if(uploadUrl.empty()){
+        uploadUrl = _create_upload_session(path);
+        offset = 0;
+        _save_upload_session(path, { {"url", uploadUrl}, {"size", fileSize} });
+    }
+
+    // chunks, except the last one, must be multiple of 256 KiB
+    int64_t chunkSize = _get_upload_chunk_size();
+    chunkSize = std::max<int64_t>(chunkSize - chunkSize % UPLOAD_CHUNK_ALIGN, UPLOAD_CHUNK_ALIGN);
+
+    httplib::Headers header = _get_headers();
+    int failures = 0;
+
+    while(true){
+        int64_t length = std::min<int64_t>(chunkSize, fileSize - offset);
+        if(source.get_progress())
+            source.get_progress()->set_done(offset);
+
+        // next chunk is read from disk while the current one is sent
+        source.prefetch(offset, length + chunkSize);
+
+        header.erase("Content-Range");
+        if(length > 0) // empty file is sent without range
+            header.emplace("Content-Range", "bytes " + std::to_string(offset) + "-" + std::to_string(offset + length - 1) + "/" + std::to_string(fileSize));
+
+        auto r = m_http_client->Put(uploadUrl.c_str(), header, length, source.provider(offset), "application/octet-stream");
+
+        // cancelled upload session is removed on server
+        if(source.is_cancelled()){
+            m_http_client->Delete(uploadUrl.c_str(), _get_headers());
+            _remove_upload_session(path);
+            throw transfer_cancelled_exception();
+        }
+
+        if(r.get() && (r->status==200 || r->status==201)){
+            _remove_upload_session(path);
+            return;
+        }
+
+        // chunk is received, server reports how much of the file it has
+        if(r.get() && r->status==308){
+            int64_t received = _get_received_size(*r);
+            if(received > offset){
+                offset = received;
+                failures = 0;
+                continue;
+            }
+
+            // chunk was not taken, it is sent again after delay
+            offset = received;
+            if(++failures > UPLOAD_RETRIES)
+                throw std::runtime_error("Upload does not progress");
+
+            _backoff(failures);
+            continue;
+        }
+
+        if(!r.get() || (r->status>=500 && r->status<600) || r->status==429 || r->status==403) {
+            if(++failures > UPLOAD_RETRIES)
+                throw_response_error(r.get());
+
+            _backoff(failures);
+
+            // resume interrupted upload (https://developers.google.com/drive/api/v3/manage-uploads#resumable),
+            // failed status query is counted with the failed chunk and tried again on the next failure
+            int64_t received = _get_upload_offset(uploadUrl, fileSize);
+            if(received == UPLOAD_OFFSET_UNKNOWN)
+                continue;
+
+            if(received == UPLOAD_OFFSET_EXPIRED){
+                _remove_upload_session(path);
+                throw service_client_exception(404, "The upload session has expired");
+            }
+
+            offset = received;
+            if(offset >= fileSize){
+                _remove_upload_session(path);
+                return;
+            }
+        } else {
+            throw_response_error(r.get());
+        }
+    }
+}
+
+void GoogleDriveClient::_backoff(int attempt)
+{
+    // exponential delay with random part, so parallel uploads do not retry at once
+    static thread_local std::mt19937 generator(std::random_device{}());
+    std::uniform_int_distribution<int> jitter(0, 1000);
+
+    int64_t delay = std::min<int64_t>(1000LL << std::min(attempt, 16), UPLOAD_MAX_BACKOFF * 1000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(delay + jitter(generator)));
+}
+
+int64_t GoogleDriveClient::_get_received_size(httplib::Response &r)
+{
+    // no Range header - nothing was received yet
+    if(!r.has_header("Range"))
+        return 0;
+
+    std::smatch m;
+    std::string range_value = r.get_header_value("Range");
+    if (std::regex_search(range_value, m, std::regex(".*=\\s*(\\d+)-(\\d+)")))
+        return std::stoll(m[2].str()) + 1;
+
+    throw std::runtime_error("Error parsing Range header");
+}
+
+std::string GoogleDriveClient::_create_upload_session(std::string &path)
 {
     std::string resourceName, parentFolderId("root");
     int p = path.find_last_of('/');
     if(p>0){
         std::string parentFolderPath = path.substr(0, p);
         resourceName = path.substr(p+1);
-        if(m_resourceNamesMap.find(parentFolderPath) != m_resourceNamesMap.end())
-            parentFolderId = m_resourceNamesMap[parentFolderPath];
+        m_resourceNamesMap.get(parentFolderPath, parentFolderId);
     } else {
         resourceName = path.substr(1);
     }
@@ -386,7 +607,7 @@ void GoogleDriveClient::uploadFile(std::string path, std::ifstream &ifstream, BO
             {"parents", {parentFolderId}}
     };
 
-    auto r = m_http_client->Post("/upload/drive/v3/files?uploadType=resumable", m_headers, jsParams.dump(), "application/json");
+    auto r = m_http_client->Post("/upload/drive/v3/files?uploadType=resumable", _get_headers(), jsParams.dump(), "application/json");
 
     if(!r.get() || r->status != 200)
         throw_response_error(r.get());
@@ -394,94 +615,140 @@ void GoogleDriveClient::uploadFile(std::string path, std::ifstream &ifstream, BO
     if(!r->has_header("Location"))
         throw std::runtime_error("Cannot find Location header");
 
-    std::string downloadUrl = r->get_header_value("Location").substr(26); // remove 'https://www.googleapis.com'
+    return r->get_header_value("Location").substr(26); // remove 'https://www.googleapis.com'
+}
 
-    ifstream.seekg(0, ifstream.end);
-    int fileSize = ifstream.tellg();
-    ifstream.seekg(0, ifstream.beg);
+int64_t GoogleDriveClient::_get_upload_offset(std::string &uploadUrl, int64_t fileSize)
+{
+    httplib::Headers header = _get_headers();
+    header.emplace("Content-Range", "bytes */" + std::to_string(fileSize));
+    std::string empty;
 
-    httplib::Headers header = m_headers;
-    int offset = 0;
-    std::stringstream body;
-    auto io_buffer = ifstream.rdbuf();
+    auto r = m_http_client->Put(uploadUrl.c_str(), header, empty, "application/octet-stream");
 
-    int count = 0;
+    if(r.get() && (r->status==200 || r->status==201))
+        return fileSize;
 
-    do{
-        io_buffer->pubseekpos(offset);
-        body.str(std::string()); // clear body
-        body << io_buffer;
+    if(r.get() && (r->status==404 || r->status==410))
+        return UPLOAD_OFFSET_EXPIRED;
 
-        r = m_http_client->Put(downloadUrl.c_str(), header, body.str(), "application/octet-stream");
+    if(r.get() && r->status==308)
+        return _get_received_size(*r);
 
-        if(r.get() && (r->status==200 || r->status==201))
-            return;
+    // the same transient errors as of chunk upload
+    if(!r.get() || (r->status>=500 && r->status<600) || r->status==429 || r->status==403)
+        return UPLOAD_OFFSET_UNKNOWN;
 
-        if(r.get() && ((r->status>=500 && r->status<600) || r->status==403)) {
-            // resume interrupted upload (https://developers.google.com/drive/api/v3/manage-uploads#resumable)
-            std::string empty;
-            header.erase("Content-Range");
-            header.emplace("Content-Range", "bytes */*");
-            r = m_http_client->Put(downloadUrl.c_str(), header, empty, "application/octet-stream");
+    throw_response_error(r.get());
+    return UPLOAD_OFFSET_EXPIRED;
+}
 
-            if(r.get() && r->status==200 || r->status==201)
-                return;
+json GoogleDriveClient::get_metadata()
+{
+    return { {"ids", m_resourceNamesMap.snapshot()}, {"mimetypes", m_mimetypesMap.snapshot()} };
+}
 
-            if(r.get() && r->status==404)
-                throw service_client_exception(404, "The upload session has expired");
+void GoogleDriveClient::set_metadata(const json &metadata)
+{
+    auto ids = metadata.find("ids");
+    if(ids != metadata.end() && ids->is_object()){
+        for(auto it = ids->begin(); it != ids->end(); ++it)
+            m_resourceNamesMap.put(it.key(), it.value().get<std::string>());
+    }
 
-            if(r.get() && r->status==308){
-                int to;
-                std::smatch m;
-                std::string range_value = r->get_header_value("Range");
-                if (std::regex_search(range_value, m, std::regex(".*=\\s*(\\d+)-(\\d+)"))) {
-                    to = std::stoi(m[2].str());
-                } else {
-                    throw std::runtime_error("Error parsing Range header");
-                }
+    auto mimetypes = metadata.find("mimetypes");
+    if(mimetypes != metadata.end() && mimetypes->is_object()){
+        for(auto it = mimetypes->begin(); it != mimetypes->end(); ++it)
+            m_mimetypesMap.put(it.key(), it.value().get<std::string>());
+    }
+}
 
-                header.erase("Content-Range");
-                offset = to + 1;
-                range_value = "bytes " + std::to_string(offset) + "-" + std::to_string(fileSize-1) + "/" + std::to_string(fileSize);
-                header.emplace("Content-Range", range_value);
-                std::this_thread::sleep_for(std::chrono::seconds(2));
+json GoogleDriveClient::get_changes(const std::string &cursor)
+{
+    if(cursor.empty()){
+        // changes refer to the real root ID instead of 'root' alias
+        auto r = m_http_client->Get("/drive/v3/files/root?fields=id", _get_headers());
+        if(!r.get() || r->status != 200)
+            throw_response_error(r.get());
+        m_resourceNamesMap.put("/", json::parse(r->body)["id"].get<std::string>());
 
-            } else {
-                throw std::runtime_error("Error uploading file");
-            }
+        r = m_http_client->Get("/drive/v3/changes/startPageToken", _get_headers());
+        if(!r.get() || r->status != 200)
+            throw_response_error(r.get());
 
-        } else {
+        json js = json::parse(r->body);
+        return { {"cursor", js["startPageToken"]}, {"paths", json::array()} };
+    }
+
+    std::map<std::string, std::string> paths;
+    for(auto& it: m_resourceNamesMap.snapshot())
+        paths[it.second] = it.first;
+
+    json result = { {"paths", json::array()} };
+    std::string pageToken = cursor;
+
+    while(true){
+        std::string url = "/drive/v3/changes?pageSize=1000&includeRemoved=true";
+        url += "&fields=nextPageToken,newStartPageToken,changes(fileId,file(name,parents))&pageToken=";
+        url += url_encode(pageToken);
+
+        auto r = m_http_client->Get(url.c_str(), _get_headers());
+        if(r.get() && (r->status == 404 || r->status == 410)){
+            json js = get_changes("");
+            js["reset"] = true;
+            return js;
+        }
+
+        if(!r.get() || r->status != 200)
             throw_response_error(r.get());
+
+        json js = json::parse(r->body);
+        for(auto& change: js["changes"]){
+            // previous location of the file
+            auto it = paths.find(change["fileId"].get<std::string>());
+            if(it != paths.end())
+                result["paths"].push_back(it->second);
+
+            // new location
+            if(change["file"].is_object() && change["file"]["parents"].is_array()){
+                for(auto& parent: change["file"]["parents"]){
+                    it = paths.find(parent.get<std::string>());
+                    if(it != paths.end())
+                        result["paths"].push_back((it->second == "/" ? "" : it->second) + "/" + change["file"]["name"].get<std::string>());
+                }
+            }
         }
 
-        count++;
-    } while(count<10);
+        if(js["newStartPageToken"].is_string()){
+            result["cursor"] = js["newStartPageToken"];
+            return result;
+        }
 
-    if(count >= 10)
-        throw std::runtime_error("Too many attempts");
+        if(!js["nextPageToken"].is_string())
+            throw std::runtime_error("Wrong Json format");
 
+        pageToken = js["nextPageToken"].get<std::string>();
+    }
 }
 
 void GoogleDriveClient::move(std::string from, std::string to, BOOL overwrite)
 {
     std::string fileId, oldParentId("root"), newParentId("root");
     int p = from.find_last_of('/');
-    if(m_resourceNamesMap.find(from) == m_resourceNamesMap.end())
+    if(!m_resourceNamesMap.contains(from))
         throw std::runtime_error("Cannot find file ID");
 
-    fileId = m_resourceNamesMap[from];
+    fileId = m_resourceNamesMap.get(from);
 
     if(p>0){
         std::string oldParentPath = from.substr(0, p);
-        if(m_resourceNamesMap.find(oldParentPath) != m_resourceNamesMap.end())
-            oldParentId = m_resourceNamesMap[oldParentPath];
+        m_resourceNamesMap.get(oldParentPath, oldParentId);
     }
 
     p = to.find_last_of('/');
     if(p>0){
         std::string newParentPath = to.substr(0, p);
-        if(m_resourceNamesMap.find(newParentPath) != m_resourceNamesMap.end())
-            newParentId = m_resourceNamesMap[newParentPath];
+        m_resourceNamesMap.get(newParentPath, newParentId);
     }
 
     std::string url("/drive/v3/files/");
@@ -491,7 +758,7 @@ void GoogleDriveClient::move(std::string from, std::string to, BOOL overwrite)
     url += "&addParents=";
     url += newParentId;
 
-    auto r = m_http_client->Patch(url.c_str(), m_headers, "", "application/json");
+    auto r = m_http_client->Patch(url.c_str(), _get_headers(), "", "application/json");
 
     if(!r.get() || r->status!=200)
         throw_response_error(r.get());
@@ -500,17 +767,16 @@ void GoogleDriveClient::move(std::string from, std::string to, BOOL overwrite)
 void GoogleDriveClient::copy(std::string from, std::string to, BOOL overwrite)
 {
     std::string fileId, toFileName, toFolderId("root");
-    if(m_resourceNamesMap.find(from) == m_resourceNamesMap.end())
+    if(!m_resourceNamesMap.contains(from))
         throw std::runtime_error("Cannot find file ID");
 
-    fileId = m_resourceNamesMap[from];
+    fileId = m_resourceNamesMap.get(from);
 
     int p = to.find_last_of('/');
     toFileName = to.substr(p + 1);
     if(p>0){
         std::string newFolderPath = to.substr(0, p);
-        if(m_resourceNamesMap.find(newFolderPath) != m_resourceNamesMap.end())
-            toFolderId = m_resourceNamesMap[newFolderPath];
+        m_resourceNamesMap.get(newFolderPath, toFolderId);
     }
 
     json jsBody = {
@@ -522,15 +788,228 @@ void GoogleDriveClient::copy(std::string from, std::string to, BOOL overwrite)
     url += fileId;
     url += "/copy";
 
-    auto r = m_http_client->Post(url.c_str(), m_headers, jsBody.dump(), "application/json");
+    auto r = m_http_client->Post(url.c_str(), _get_headers(), jsBody.dump(), "application/json");
+
+    if(!r.get() || r->status!=200)
+        throw_response_error(r.get());
+}
+
+void GoogleDriveClient::run_batch(std::vector<BatchOperation>& operations)
+{
+    // calls of one request are run by Drive in any order, so one request takes
+    // operations of one type on unrelated paths, consecutive requests keep the order
+    size_t start = 0;
+    while(start < operations.size()){
+        size_t end = start + 1;
+        while(end < operations.size() && end - start < DRIVE_BATCH_LIMIT && operations[end].type == operations[start].type){
+            bool related = false;
+            for(size_t i=start; i<end && !related; i++)
+                related = is_related_path(operations[i].from, operations[end].from) || is_related_path(operations[i].from, operations[end].to)
+                          || is_related_path(operations[i].to, operations[end].from) || is_related_path(operations[i].to, operations[end].to);
+            if(related)
+                break;
+            end++;
+        }
+
+        // results of previous requests are known here
+        _skip_deletes(operations, start, end);
+        _run_batch(operations, start, end);
+
+        start = end;
+    }
+}
+
+void GoogleDriveClient::_run_batch(std::vector<BatchOperation>& operations, size_t start, size_t end)
+{
+    std::vector<size_t> pending;
+    std::vector<DriveBatchPart> parts;
+    for(size_t i=start; i<end; i++){
+        if(!operations[i].error.empty())
+            continue;
+
+        DriveBatchPart part;
+        std::string error;
+        if(_get_batch_part(operations[i], part, error)){
+            pending.push_back(i);
+            parts.push_back(part);
+        } else {
+            operations[i].error = error;
+        }
+    }
+
+    // calls limited by rate or failed on server side are sent again
+    for(int attempt=1; !parts.empty(); attempt++){
+        std::vector<DriveBatchResult> results;
+        try{
+            results = _send_batch(parts);
+        } catch (std::exception & e){
+            for(size_t i: pending)
+                operations[i].error = e.what();
+            break;
+        }
+
+        std::vector<size_t> retry;
+        std::vector<DriveBatchPart> retryParts;
+        for(size_t k=0; k<results.size(); k++){
+            BatchOperation& operation = operations[pending[k]];
+            int status = results[k].status;
+
+            if(status >= 200 && status < 300){
+                if(operation.type == "move"){
+                    m_resourceNamesMap.put(operation.to, m_resourceNamesMap.get(operation.from));
+                    m_mimetypesMap.put(operation.to, m_mimetypesMap.get(operation.from));
+                } else if(operation.type == "copy"){
+                    json js = json::parse(results[k].body, nullptr, false);
+                    if(js.is_object() && js["id"].is_string())
+                        m_resourceNamesMap.put(operation.to, js["id"].get<std::string>());
+                    if(js.is_object() && js["mimeType"].is_string())
+                        m_mimetypesMap.put(operation.to, js["mimeType"].get<std::string>());
+                }
+                continue;
+            }
+
+            // already deleted, i.e. together with its folder
+            if(operation.type == "delete" && status == 404)
+                continue;
+
+            if((status == 0 || status == 403 || status == 429 || status >= 500) && attempt < UPLOAD_RETRIES){
+                retry.push_back(pending[k]);
+                retryParts.push_back(parts[k]);
+                continue;
+            }
+
+            std::string message = "Error code: " + std::to_string(status);
+            json js = json::parse(results[k].body, nullptr, false);
+            if(js.is_object() && js["error"].is_object() && js["error"]["message"].is_string())
+                message = js["error"]["message"].get<std::string>();
+            operation.error = message;
+        }
+
+        pending.swap(retry);
+        parts.swap(retryParts);
+        if(!parts.empty())
+            _backoff(attempt);
+    }
+}
+
+bool GoogleDriveClient::_get_batch_part(const BatchOperation& operation, DriveBatchPart& part, std::string& error)
+{
+    std::string fileId;
+    if(!m_resourceNamesMap.get(operation.from, fileId)){
+        error = "Cannot find file ID";
+        return false;
+    }
 
+    std::string toFolderId("root");
+    int p = operation.to.find_last_of('/');
+    if(p>0)
+        m_resourceNamesMap.get(operation.to.substr(0, p), toFolderId);
+
+    // same calls as removeResource, move and copy do one by one
+    if(operation.type == "delete"){
+        part.method = "DELETE";
+        part.url = "/drive/v3/files/" + fileId;
+    } else if(operation.type == "move"){
+        std::string fromFolderId("root");
+        p = operation.from.find_last_of('/');
+        if(p>0)
+            m_resourceNamesMap.get(operation.from.substr(0, p), fromFolderId);
+
+        part.method = "PATCH";
+        part.url = "/drive/v3/files/" + fileId + "?removeParents=" + fromFolderId + "&addParents=" + toFolderId;
+        part.body = "{}";
+    } else if(operation.type == "copy"){
+        json jsBody = {
+                {"name", operation.to.substr(operation.to.find_last_of('/') + 1)},
+                {"parents", {toFolderId}},
+        };
+
+        part.method = "POST";
+        part.url = "/drive/v3/files/" + fileId + "/copy?fields=id,mimeType";
+        part.body = jsBody.dump();
+    } else {
+        error = "Unknown batch operation: " + operation.type;
+        return false;
+    }
+
+    return true;
+}
+
+std::vector<DriveBatchResult> GoogleDriveClient::_send_batch(const std::vector<DriveBatchPart>& parts)
+{
+    static thread_local std::mt19937 generator(std::random_device{}());
+    std::string boundary = "batch_" + std::to_string(generator());
+
+    // https://developers.google.com/drive/api/v3/batch
+    std::string body;
+    for(size_t i=0; i<parts.size(); i++){
+        body += "--" + boundary + "\r\n";
+        body += "Content-Type: application/http\r\n";
+        body += "Content-ID: <item" + std::to_string(i) + ">\r\n\r\n";
+        body += parts[i].method + " " + parts[i].url + " HTTP/1.1\r\n";
+        if(!parts[i].body.empty()){
+            body += "Content-Type: application/json; charset=UTF-8\r\n\r\n";
+            body += parts[i].body + "\r\n";
+        } else {
+            body += "\r\n";
+        }
+    }
+    body += "--" + boundary + "--\r\n";
+
+    httplib::Headers hd = _get_headers();
+    hd.erase("Accept");
+
+    std::string contentType = "multipart/mixed; boundary=" + boundary;
+    auto r = m_http_client->Post("/batch/drive/v3", hd, body, contentType.c_str());
     if(!r.get() || r->status!=200)
         throw_response_error(r.get());
+
+    return _parse_batch_response(*r, parts.size());
+}
+
+std::vector<DriveBatchResult> GoogleDriveClient::_parse_batch_response(httplib::Response& r, size_t count)
+{
+    std::vector<DriveBatchResult> results(count, DriveBatchResult{0, ""});
+
+    std::smatch m;
+    std::string contentType = r.get_header_value("Content-Type");
+    if(!std::regex_search(contentType, m, std::regex("boundary=\"?([^\";]+)\"?")))
+        throw std::runtime_error("Error parsing batch response");
+
+    std::string delimiter = "--" + m[1].str();
+    size_t pos = r.body.find(delimiter);
+    while(pos != std::string::npos){
+        pos += delimiter.size();
+        size_t next = r.body.find(delimiter, pos);
+        if(next == std::string::npos)
+            break;
+
+        std::string part = r.body.substr(pos, next - pos);
+        pos = next;
+
+        // part headers, then http status line with headers, then body; parts can be in any order
+        if(!std::regex_search(part, m, std::regex("Content-ID:\\s*<response-item(\\d+)>", std::regex::icase)))
+            continue;
+        size_t index = std::stoul(m[1].str());
+
+        if(index >= count || !std::regex_search(part, m, std::regex("HTTP/1\\.1 (\\d+)")))
+            continue;
+        results[index].status = std::stoi(m[1].str());
+
+        size_t bodyStart = part.find("\r\n\r\n", m.position(0));
+        if(bodyStart != std::string::npos){
+            results[index].body = part.substr(bodyStart + 4);
+            while(!results[index].body.empty() && (results[index].body.back() == '\n' || results[index].body.back() == '\r'))
+                results[index].body.pop_back();
+        }
+    }
+
+    return results;
 }
 
 void GoogleDriveClient::cleanTrash()
 {
-    auto r = m_http_client->Delete("/drive/v3/files/trash", m_headers);
+    auto r = m_http_client->Delete("/drive/v3/files/trash", _get_headers());
 
     if(!r.get() || r->status<=200 || r->status>=300)
         throw_response_error(r.get());
@@ -22,10 +22,27 @@ License along with this library; if not, write to the Free Software
 #define CLOUD_STORAGE_GOOGLEDRIVE_CLIENT_H
 
 #define CPPHTTPLIB_OPENSSL_SUPPORT
+#include <future>
 #include "service_client.h"
+#include "path_map.h"
 #include "httplib.h"
 #include "../library.h"
 
+// max calls in one multipart request to /batch/drive/v3
+#define DRIVE_BATCH_LIMIT 100
+
+// one call of the multipart batch request
+struct DriveBatchPart {
+    std::string method;
+    std::string url;
+    std::string body;
+};
+
+struct DriveBatchResult {
+    int status;
+    std::string body;
+};
+
 class GoogleDriveClient: public ServiceClient {
 public:
     GoogleDriveClient();
@@ -45,9 +62,9 @@ public:
 
     void removeResource(std::string utf8Path);
 
-    void downloadFile(std::string path, std::ofstream &ofstream, std::string localPath);
+    void downloadFile(std::string path, std::ofstream &ofstream, std::string localPath, uint64_t offset, TransferProgress* progress);
 
-    void uploadFile(std::string path, std::ifstream &ifstream, BOOL overwrite);
+    void uploadFile(std::string path, UploadSource &source, BOOL overwrite, BOOL resume);
 
     void move(std::string from, std::string to, BOOL overwrite);
 
@@ -63,16 +80,42 @@ public:
 
     void run_command(std::string remoteName, std::vector<std::string> &arguments) {}
 
+    json get_metadata();
+
+    void set_metadata(const json& metadata);
+
+    json get_changes(const std::string& cursor);
+
+    size_t get_batch_limit() { return DRIVE_BATCH_LIMIT; }
+
+    void run_batch(std::vector<BatchOperation>& operations);
+
 private:
     std::string token;
     httplib::SSLClient* m_http_client;
-    httplib::Headers m_headers;
 
-    std::map<std::string, std::string> m_resourceNamesMap;
-    std::map<std::string, std::string> m_mimetypesMap;
+    PathMap m_resourceNamesMap;
+    PathMap m_mimetypesMap;
 
     void throw_response_error(httplib::Response* resp);
     pResources prepare_folder_result(json json, std::string& path);
+    void _add_folder_items(json& js, pResources pRes, std::string& path);
+    // next listing page is downloaded in background over its own connection
+    std::future<std::shared_ptr<httplib::Response>> _get_page_async(const std::string& url);
+
+    std::string _create_upload_session(std::string &path);
+    // returns UPLOAD_OFFSET_EXPIRED if upload session has expired,
+    // UPLOAD_OFFSET_UNKNOWN if status query failed and can be repeated
+    int64_t _get_upload_offset(std::string &uploadUrl, int64_t fileSize);
+    int64_t _get_received_size(httplib::Response &r);
+    void _backoff(int attempt);
+
+    // returns false and sets error if file ID of operation is unknown
+    void _run_batch(std::vector<BatchOperation>& operations, size_t start, size_t end);
+    bool _get_batch_part(const BatchOperation& operation, DriveBatchPart& part, std::string& error);
+    // results in the order of parts, status is 0 if part has no response
+    std::vector<DriveBatchResult> _send_batch(const std::vector<DriveBatchPart>& parts);
+    std::vector<DriveBatchResult> _parse_batch_response(httplib::Response& r, size_t count);
 };
 
 
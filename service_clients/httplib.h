@@ -55,10 +55,13 @@ typedef int socket_t;
 #define INVALID_SOCKET (-1)
 #endif //_WIN32
 
+#include <chrono>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <map>
 #include <memory>
+#include <condition_variable>
 #include <mutex>
 #include <regex>
 #include <string>
@@ -80,6 +83,10 @@ typedef int socket_t;
  */
 #define CPPHTTPLIB_KEEPALIVE_TIMEOUT_SECOND 5
 #define CPPHTTPLIB_KEEPALIVE_TIMEOUT_USECOND 0
+#define CPPHTTPLIB_RECV_BUFSIZ size_t(16384u)
+#define CPPHTTPLIB_POOL_MAX_IDLE_PER_HOST 8
+#define CPPHTTPLIB_POOL_IDLE_TIMEOUT_SECOND 30
+#define CPPHTTPLIB_POOL_MAX_ACTIVE_PER_HOST 16
 
 namespace httplib
 {
@@ -109,6 +116,15 @@ std::pair<std::string, std::string> make_range_header(uint64_t value, Args... ar
 typedef std::multimap<std::string, std::string>                Params;
 typedef std::smatch                                            Match;
 typedef std::function<bool (uint64_t current, uint64_t total)> Progress;
+typedef std::function<bool (const char* data, size_t data_length)> ContentReceiver;
+
+struct Response;
+typedef std::function<bool (const Response& response)> ResponseHandler;
+
+// request body is written by the provider in pieces, starting from the offset,
+// sink returns false when the data cannot be sent
+typedef std::function<bool (const char* data, size_t data_length)> DataSink;
+typedef std::function<bool (uint64_t offset, uint64_t length, DataSink sink)> ContentProvider;
 
 struct MultipartFile {
     std::string filename;
@@ -129,7 +145,12 @@ struct Request {
     MultipartFiles files;
     Match          matches;
 
-    Progress       progress;
+    Progress        progress;
+    ContentReceiver content_receiver;
+    ResponseHandler response_handler;
+
+    uint64_t        content_length = 0;
+    ContentProvider content_provider;
 
     bool has_header(const char* key) const;
     std::string get_header_value(const char* key, size_t id = 0) const;
@@ -275,6 +296,70 @@ private:
     int         running_threads_;
 };
 
+struct ConnectionPoolStats {
+    uint64_t created = 0;
+    uint64_t reused = 0;
+    uint64_t evicted = 0;
+    uint64_t waited = 0;
+    size_t   idle = 0;
+    size_t   active = 0;
+};
+
+// Idle keep-alive connections shared between clients, keyed by scheme, host and port.
+// Connections idle longer than timeout or closed by the peer are evicted on acquire.
+// Number of connections in use per key is limited, acquire waits for a free one.
+class ConnectionPool {
+public:
+    ConnectionPool(
+        size_t max_idle_per_host = CPPHTTPLIB_POOL_MAX_IDLE_PER_HOST,
+        time_t idle_timeout_sec = CPPHTTPLIB_POOL_IDLE_TIMEOUT_SECOND,
+        size_t max_active_per_host = CPPHTTPLIB_POOL_MAX_ACTIVE_PER_HOST);
+
+    ~ConnectionPool();
+
+    void set_max_idle_per_host(size_t count);
+    void set_idle_timeout(time_t sec);
+    // 0 - not limited
+    void set_max_active_per_host(size_t count);
+
+    ConnectionPoolStats get_stats();
+
+    // close all idle connections
+    void clear();
+
+private:
+    friend class Client;
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+    friend class SSLClient;
+#endif
+
+    struct Connection {
+        socket_t sock = INVALID_SOCKET;
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+        SSL*     ssl = nullptr;
+#endif
+        std::chrono::steady_clock::time_point idle_since;
+    };
+
+    // takes a slot of the key, returns true if idle connection is reused
+    bool acquire(const std::string& key, Connection& conn);
+    // keeps connection for reuse and frees the slot
+    void release(const std::string& key, Connection conn);
+    // closes connection and frees the slot
+    void discard(const std::string& key, Connection& conn);
+    void add_created();
+    static void close(Connection& conn);
+
+    std::mutex mutex_;
+    std::condition_variable slot_cv_;
+    std::map<std::string, std::deque<Connection>> idle_;
+    std::map<std::string, size_t> active_;
+    size_t max_idle_per_host_;
+    time_t idle_timeout_sec_;
+    size_t max_active_per_host_;
+    ConnectionPoolStats stats_;
+};
+
 class Client {
 public:
     Client(
@@ -288,18 +373,23 @@ public:
 
     std::shared_ptr<Response> Get(const char* path, Progress progress = nullptr);
     std::shared_ptr<Response> Get(const char* path, const Headers& headers, Progress progress = nullptr);
+    std::shared_ptr<Response> Get(const char* path, const Headers& headers, ContentReceiver content_receiver, Progress progress = nullptr);
 
     std::shared_ptr<Response> Head(const char* path);
     std::shared_ptr<Response> Head(const char* path, const Headers& headers);
 
     std::shared_ptr<Response> Post(const char* path, const std::string& body, const char* content_type);
     std::shared_ptr<Response> Post(const char* path, const Headers& headers, const std::string& body, const char* content_type);
+    std::shared_ptr<Response> Post(const char* path, const Headers& headers, const std::string& body, const char* content_type, ContentReceiver content_receiver);
+
+    std::shared_ptr<Response> Post(const char* path, const Headers& headers, uint64_t content_length, ContentProvider content_provider, const char* content_type);
 
     std::shared_ptr<Response> Post(const char* path, const Params& params);
     std::shared_ptr<Response> Post(const char* path, const Headers& headers, const Params& params);
 
     std::shared_ptr<Response> Put(const char* path, const std::string& body, const char* content_type);
     std::shared_ptr<Response> Put(const char* path, const Headers& headers, const std::string& body, const char* content_type);
+    std::shared_ptr<Response> Put(const char* path, const Headers& headers, uint64_t content_length, ContentProvider content_provider, const char* content_type);
 
     std::shared_ptr<Response> Patch(const char* path, const Headers& headers, const std::string& body, const char* content_type);
 
@@ -311,6 +401,9 @@ public:
 
     bool send(Request& req, Response& res);
 
+    // keep connections alive and reuse them through the pool
+    void set_connection_pool(ConnectionPool* pool);
+
 protected:
     bool process_request(Stream& strm, Request& req, Response& res, bool& connection_close);
 
@@ -318,11 +411,16 @@ protected:
     const int         port_;
     time_t            timeout_sec_;
     const std::string host_and_port_;
+    ConnectionPool*   pool_;
+
+    virtual bool open_connection(ConnectionPool::Connection& conn);
+    virtual bool process_connection(ConnectionPool::Connection& conn, Request& req, Response& res, bool& connection_close);
 
 private:
     socket_t create_client_socket() const;
     bool read_response_line(Stream& strm, Response& res);
-    void write_request(Stream& strm, Request& req);
+    bool write_request(Stream& strm, Request& req);
+    bool send_pooled(Request& req, Response& res);
 
     virtual bool read_and_close_socket(socket_t sock, Request& req, Response& res);
     virtual bool is_ssl() const;
@@ -360,6 +458,38 @@ private:
     std::mutex ctx_mutex_;
 };
 
+struct SSLSessionCacheStats {
+    uint64_t full = 0;
+    uint64_t resumed = 0;
+    size_t   sessions = 0;
+};
+
+// Last TLS session of every host, so next handshakes with it are abbreviated.
+// Sessions (including TLS 1.3 tickets) are received by the new session callback.
+class SSLSessionCache {
+public:
+    SSLSessionCache() = default;
+    ~SSLSessionCache();
+
+    SSLSessionCacheStats get_stats();
+
+    void clear();
+
+private:
+    friend class SSLClient;
+
+    // returns referenced session, caller should free it
+    SSL_SESSION* get(const std::string& host);
+    void put(const std::string& host, SSL_SESSION* session);
+    void add_handshake(bool resumed);
+
+    static int new_session_cb(SSL* ssl, SSL_SESSION* session);
+
+    std::mutex mutex_;
+    std::map<std::string, SSL_SESSION*> sessions_;
+    SSLSessionCacheStats stats_;
+};
+
 class SSLClient : public Client {
 public:
     SSLClient(
@@ -371,12 +501,21 @@ public:
 
     virtual bool is_valid() const;
 
+    // resume TLS sessions from the cache
+    void set_session_cache(SSLSessionCache* cache);
+
 private:
+    void setup_ssl(SSL* ssl);
+    int connect_ssl(SSL* ssl);
+
     virtual bool read_and_close_socket(socket_t sock, Request& req, Response& res);
+    virtual bool open_connection(ConnectionPool::Connection& conn);
+    virtual bool process_connection(ConnectionPool::Connection& conn, Request& req, Response& res, bool& connection_close);
     virtual bool is_ssl() const;
 
     SSL_CTX* ctx_;
     std::mutex ctx_mutex_;
+    SSLSessionCache* session_cache_;
 };
 #endif
 
@@ -795,6 +934,15 @@ inline int get_header_value_int(const Headers& headers, const char* key, int def
     return def;
 }
 
+inline uint64_t get_header_value_uint64(const Headers& headers, const char* key, uint64_t def = 0)
+{
+    auto it = headers.find(key);
+    if (it != headers.end()) {
+        return std::stoull(it->second);
+    }
+    return def;
+}
+
 inline bool read_headers(Stream& strm, Headers& headers)
 {
     static std::regex re(R"((.+?):\s*(.+?)\s*\r\n)");
@@ -822,16 +970,22 @@ inline bool read_headers(Stream& strm, Headers& headers)
     return true;
 }
 
-inline bool read_content_with_length(Stream& strm, std::string& out, size_t len, Progress progress)
+inline bool read_content_with_length(Stream& strm, uint64_t len, Progress progress, ContentReceiver out)
 {
-    out.assign(len, 0);
-    size_t r = 0;
+    char buf[CPPHTTPLIB_RECV_BUFSIZ];
+
+    uint64_t r = 0;
     while (r < len){
-        auto n = strm.read(&out[r], len - r);
+        auto read_len = static_cast<size_t>(std::min<uint64_t>(len - r, CPPHTTPLIB_RECV_BUFSIZ));
+        auto n = strm.read(buf, read_len);
         if (n <= 0) {
             return false;
         }
 
+        if (!out(buf, n)) {
+            return false;
+        }
+
         r += n;
 
         if (progress) {
@@ -844,23 +998,27 @@ inline bool read_content_with_length(Stream& strm, std::string& out, size_t len,
     return true;
 }
 
-inline bool read_content_without_length(Stream& strm, std::string& out)
+inline bool read_content_without_length(Stream& strm, ContentReceiver out)
 {
+    char buf[CPPHTTPLIB_RECV_BUFSIZ];
+
     for (;;) {
-        char byte;
-        auto n = strm.read(&byte, 1);
+        auto n = strm.read(buf, CPPHTTPLIB_RECV_BUFSIZ);
         if (n < 0) {
             return false;
         } else if (n == 0) {
             return true;
         }
-        out += byte;
+
+        if (!out(buf, n)) {
+            return false;
+        }
     }
 
     return true;
 }
 
-inline bool read_content_chunked(Stream& strm, std::string& out)
+inline bool read_content_chunked(Stream& strm, ContentReceiver out)
 {
     const auto bufsiz = 16;
     char buf[bufsiz];
@@ -871,11 +1029,10 @@ inline bool read_content_chunked(Stream& strm, std::string& out)
         return false;
     }
 
-    auto chunk_len = std::stoi(reader.ptr(), 0, 16);
+    auto chunk_len = std::stoull(reader.ptr(), 0, 16);
 
     while (chunk_len > 0){
-        std::string chunk;
-        if (!read_content_with_length(strm, chunk, chunk_len, nullptr)) {
+        if (!read_content_with_length(strm, chunk_len, nullptr, out)) {
             return false;
         }
 
@@ -887,13 +1044,11 @@ inline bool read_content_chunked(Stream& strm, std::string& out)
             break;
         }
 
-        out += chunk;
-
         if (!reader.getline()) {
             return false;
         }
 
-        chunk_len = std::stoi(reader.ptr(), 0, 16);
+        chunk_len = std::stoull(reader.ptr(), 0, 16);
     }
 
     if (chunk_len == 0) {
@@ -905,24 +1060,50 @@ inline bool read_content_chunked(Stream& strm, std::string& out)
     return true;
 }
 
+// Content is appended to x.body unless a receiver is given,
+// in that case every received block is passed to it as is.
 template <typename T>
-bool read_content(Stream& strm, T& x, Progress progress = Progress())
+bool read_content(Stream& strm, T& x, Progress progress = Progress(), ContentReceiver receiver = nullptr)
 {
+    ContentReceiver out = receiver;
+    if (!out) {
+        out = [&](const char* data, size_t data_length) {
+            x.body.append(data, data_length);
+            return true;
+        };
+    }
+
     if (has_header(x.headers, "Content-Length")) {
-        auto len = get_header_value_int(x.headers, "Content-Length", 0);
+        auto len = get_header_value_uint64(x.headers, "Content-Length", 0);
         if (len == 0) {
             const auto& encoding = get_header_value(x.headers, "Transfer-Encoding", 0, "");
             if (!strcasecmp(encoding, "chunked")) {
-                return read_content_chunked(strm, x.body);
+                return read_content_chunked(strm, out);
             }
         }
-        return read_content_with_length(strm, x.body, len, progress);
+        if (!receiver) {
+            x.body.reserve(len);
+        }
+        return read_content_with_length(strm, len, progress, out);
     } else {
         const auto& encoding = get_header_value(x.headers, "Transfer-Encoding", 0, "");
         if (!strcasecmp(encoding, "chunked")) {
-            return read_content_chunked(strm, x.body);
+            return read_content_chunked(strm, out);
+        }
+        return read_content_without_length(strm, out);
+    }
+    return true;
+}
+
+inline bool write_data(Stream& strm, const char* data, size_t size)
+{
+    while (size > 0) {
+        auto n = strm.write(data, size);
+        if (n <= 0) {
+            return false;
         }
-        return read_content_without_length(strm, x.body);
+        data += n;
+        size -= n;
     }
     return true;
 }
@@ -1983,6 +2164,7 @@ inline Client::Client(
     , port_(port)
     , timeout_sec_(timeout_sec)
     , host_and_port_(host_ + ":" + std::to_string(port_))
+    , pool_(nullptr)
 {
 }
 
@@ -2043,6 +2225,10 @@ inline bool Client::send(Request& req, Response& res)
         return false;
     }
 
+    if (pool_) {
+        return send_pooled(req, res);
+    }
+
     auto sock = create_client_socket();
     if (sock == INVALID_SOCKET) {
         return false;
@@ -2051,7 +2237,71 @@ inline bool Client::send(Request& req, Response& res)
     return read_and_close_socket(sock, req, res);
 }
 
-inline void Client::write_request(Stream& strm, Request& req)
+inline void Client::set_connection_pool(ConnectionPool* pool)
+{
+    pool_ = pool;
+}
+
+inline bool Client::send_pooled(Request& req, Response& res)
+{
+    const auto key = std::string(is_ssl() ? "https://" : "http://") + host_and_port_;
+    const auto headers = req.headers;
+
+    ConnectionPool::Connection conn;
+    auto reused = pool_->acquire(key, conn);
+    if (!reused) {
+        if (!open_connection(conn)) {
+            pool_->discard(key, conn);
+            return false;
+        }
+        pool_->add_created();
+    }
+
+    auto connection_close = false;
+    auto ret = process_connection(conn, req, res, connection_close);
+
+    // idle connection could be closed by the server meanwhile, repeat the request once
+    // over a new one if nothing was received. Server could run the request before closing,
+    // so only requests which can be repeated safely are sent again
+    auto idempotent = req.method == "GET" || req.method == "HEAD" || req.method == "PUT" ||
+                      req.method == "DELETE" || req.method == "OPTIONS";
+    if (!ret && reused && res.status == -1 && idempotent) {
+        ConnectionPool::close(conn);
+
+        req.headers = headers;
+        res = Response();
+        if (!open_connection(conn)) {
+            pool_->discard(key, conn);
+            return false;
+        }
+        pool_->add_created();
+
+        connection_close = false;
+        ret = process_connection(conn, req, res, connection_close);
+    }
+
+    if (ret && !connection_close) {
+        pool_->release(key, conn);
+    } else {
+        pool_->discard(key, conn);
+    }
+
+    return ret;
+}
+
+inline bool Client::open_connection(ConnectionPool::Connection& conn)
+{
+    conn.sock = create_client_socket();
+    return conn.sock != INVALID_SOCKET;
+}
+
+inline bool Client::process_connection(ConnectionPool::Connection& conn, Request& req, Response& res, bool& connection_close)
+{
+    SocketStream strm(conn.sock);
+    return process_request(strm, req, res, connection_close);
+}
+
+inline bool Client::write_request(Stream& strm, Request& req)
 {
     BufferStream bstrm;
 
@@ -2085,12 +2335,19 @@ inline void Client::write_request(Stream& strm, Request& req)
         req.set_header("User-Agent", "cpp-httplib/0.2");
     }
 
-    // TODO: Support KeepAlive connection
-    // if (!req.has_header("Connection")) {
+    // HTTP/1.1 connections are persistent by default
+    if (!pool_) {
         req.set_header("Connection", "close");
-    // }
+    }
 
-    if (req.body.empty()) {
+    if (req.content_provider) {
+        if (!req.has_header("Content-Type")) {
+            req.set_header("Content-Type", "text/plain");
+        }
+
+        auto length = std::to_string(req.content_length);
+        req.set_header("Content-Length", length.c_str());
+    } else if (req.body.empty()) {
         if (req.method == "POST" || req.method == "PUT") {
             req.set_header("Content-Length", "0");
         }
@@ -2112,13 +2369,38 @@ inline void Client::write_request(Stream& strm, Request& req)
 
     // Flush buffer
     auto& data = bstrm.get_buffer();
-    strm.write(data.data(), data.size());
+    if (!detail::write_data(strm, data.data(), data.size())) {
+        return false;
+    }
+
+    // Streamed body goes directly to the connection
+    if (req.content_provider) {
+        uint64_t offset = 0;
+        DataSink sink = [&](const char* d, size_t n) {
+            if (!detail::write_data(strm, d, n)) {
+                return false;
+            }
+            offset += n;
+            return true;
+        };
+
+        while (offset < req.content_length) {
+            auto last = offset;
+            if (!req.content_provider(offset, req.content_length - offset, sink) || offset == last) {
+                return false;
+            }
+        }
+    }
+
+    return true;
 }
 
 inline bool Client::process_request(Stream& strm, Request& req, Response& res, bool& connection_close)
 {
     // Send request
-    write_request(strm, req);
+    if (!write_request(strm, req)) {
+        return false;
+    }
 
     // Receive response and headers
     if (!read_response_line(strm, res) || !detail::read_headers(strm, res.headers)) {
@@ -2129,9 +2411,27 @@ inline bool Client::process_request(Stream& strm, Request& req, Response& res, b
         connection_close = true;
     }
 
+    // the handler can reject response by its status and headers before the body is read
+    if (req.response_handler && !req.response_handler(res)) {
+        return false;
+    }
+
     // Body
-    if (req.method != "HEAD") {
-        if (!detail::read_content(strm, res, req.progress)) {
+    if (req.method != "HEAD" && res.status != 204 && res.status != 304) {
+        // body without length is read up to the end of connection
+        if (!res.has_header("Content-Length") &&
+            strcasecmp(res.get_header_value("Transfer-Encoding").c_str(), "chunked")) {
+            connection_close = true;
+        }
+
+        // only successful responses are streamed to the receiver,
+        // error bodies are kept in res.body for error reporting
+        ContentReceiver receiver;
+        if (req.content_receiver && res.status >= 200 && res.status < 300) {
+            receiver = req.content_receiver;
+        }
+
+        if (!detail::read_content(strm, res, req.progress, receiver)) {
             return false;
         }
 
@@ -2180,6 +2480,21 @@ inline std::shared_ptr<Response> Client::Get(const char* path, const Headers& he
     return send(req, *res) ? res : nullptr;
 }
 
+inline std::shared_ptr<Response> Client::Get(
+    const char* path, const Headers& headers, ContentReceiver content_receiver, Progress progress)
+{
+    Request req;
+    req.method = "GET";
+    req.path = path;
+    req.headers = headers;
+    req.content_receiver = content_receiver;
+    req.progress = progress;
+
+    auto res = std::make_shared<Response>();
+
+    return send(req, *res) ? res : nullptr;
+}
+
 inline std::shared_ptr<Response> Client::Head(const char* path)
 {
     return Head(path, Headers());
@@ -2219,6 +2534,42 @@ inline std::shared_ptr<Response> Client::Post(
     return send(req, *res) ? res : nullptr;
 }
 
+inline std::shared_ptr<Response> Client::Post(
+    const char* path, const Headers& headers, const std::string& body, const char* content_type,
+    ContentReceiver content_receiver)
+{
+    Request req;
+    req.method = "POST";
+    req.headers = headers;
+    req.path = path;
+
+    req.headers.emplace("Content-Type", content_type);
+    req.body = body;
+    req.content_receiver = content_receiver;
+
+    auto res = std::make_shared<Response>();
+
+    return send(req, *res) ? res : nullptr;
+}
+
+inline std::shared_ptr<Response> Client::Post(
+    const char* path, const Headers& headers, uint64_t content_length, ContentProvider content_provider,
+    const char* content_type)
+{
+    Request req;
+    req.method = "POST";
+    req.headers = headers;
+    req.path = path;
+
+    req.headers.emplace("Content-Type", content_type);
+    req.content_length = content_length;
+    req.content_provider = content_provider;
+
+    auto res = std::make_shared<Response>();
+
+    return send(req, *res) ? res : nullptr;
+}
+
 inline std::shared_ptr<Response> Client::Post(const char* path, const Params& params)
 {
     return Post(path, Headers(), params);
@@ -2261,6 +2612,24 @@ inline std::shared_ptr<Response> Client::Put(
     return send(req, *res) ? res : nullptr;
 }
 
+inline std::shared_ptr<Response> Client::Put(
+    const char* path, const Headers& headers, uint64_t content_length, ContentProvider content_provider,
+    const char* content_type)
+{
+    Request req;
+    req.method = "PUT";
+    req.headers = headers;
+    req.path = path;
+
+    req.headers.emplace("Content-Type", content_type);
+    req.content_length = content_length;
+    req.content_provider = content_provider;
+
+    auto res = std::make_shared<Response>();
+
+    return send(req, *res) ? res : nullptr;
+}
+
 inline std::shared_ptr<Response> Client::Patch(
             const char* path, const Headers& headers, const std::string& body, const char* content_type)
 {
@@ -2312,6 +2681,169 @@ inline std::shared_ptr<Response> Client::Options(const char* path, const Headers
     return send(req, *res) ? res : nullptr;
 }
 
+// Connection pool implementation
+inline ConnectionPool::ConnectionPool(size_t max_idle_per_host, time_t idle_timeout_sec, size_t max_active_per_host)
+    : max_idle_per_host_(max_idle_per_host)
+    , idle_timeout_sec_(idle_timeout_sec)
+    , max_active_per_host_(max_active_per_host)
+{
+}
+
+inline ConnectionPool::~ConnectionPool()
+{
+    clear();
+}
+
+inline void ConnectionPool::set_max_idle_per_host(size_t count)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    max_idle_per_host_ = count;
+}
+
+inline void ConnectionPool::set_idle_timeout(time_t sec)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    idle_timeout_sec_ = sec;
+}
+
+inline void ConnectionPool::set_max_active_per_host(size_t count)
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        max_active_per_host_ = count;
+    }
+    slot_cv_.notify_all();
+}
+
+inline ConnectionPoolStats ConnectionPool::get_stats()
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto stats = stats_;
+    stats.idle = 0;
+    for (auto& it: idle_) {
+        stats.idle += it.second.size();
+    }
+    for (auto& it: active_) {
+        stats.active += it.second;
+    }
+    return stats;
+}
+
+inline void ConnectionPool::clear()
+{
+    std::map<std::string, std::deque<Connection>> idle;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        idle.swap(idle_);
+    }
+
+    for (auto& it: idle) {
+        for (auto& conn: it.second) {
+            close(conn);
+        }
+    }
+}
+
+inline bool ConnectionPool::acquire(const std::string& key, Connection& conn)
+{
+    std::vector<Connection> expired;
+    auto found = false;
+    {
+        std::unique_lock<std::mutex> guard(mutex_);
+
+        // requests over the limit wait for a connection to be returned
+        auto& active = active_[key];
+        if (max_active_per_host_ > 0 && active >= max_active_per_host_) {
+            stats_.waited++;
+            slot_cv_.wait(guard, [&]() { return max_active_per_host_ == 0 || active < max_active_per_host_; });
+        }
+        active++;
+
+        auto& idle = idle_[key];
+        auto deadline = std::chrono::steady_clock::now() - std::chrono::seconds(idle_timeout_sec_);
+
+        // the oldest connections are at the front
+        while (!idle.empty() && idle.front().idle_since < deadline) {
+            expired.push_back(idle.front());
+            idle.pop_front();
+        }
+
+        while (!idle.empty()) {
+            conn = idle.back();
+            idle.pop_back();
+
+            // idle connection must not have anything to read, otherwise it is closed by the peer
+            if (detail::select_read(conn.sock, 0, 0) == 0) {
+                found = true;
+                break;
+            }
+            expired.push_back(conn);
+        }
+
+        stats_.evicted += expired.size();
+        if (found) {
+            stats_.reused++;
+        }
+    }
+
+    for (auto& c: expired) {
+        close(c);
+    }
+
+    return found;
+}
+
+inline void ConnectionPool::release(const std::string& key, Connection conn)
+{
+    auto kept = false;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        active_[key]--;
+        auto& idle = idle_[key];
+        if (idle.size() < max_idle_per_host_) {
+            conn.idle_since = std::chrono::steady_clock::now();
+            idle.push_back(conn);
+            kept = true;
+        }
+    }
+    slot_cv_.notify_all();
+
+    if (!kept) {
+        close(conn);
+    }
+}
+
+inline void ConnectionPool::discard(const std::string& key, Connection& conn)
+{
+    close(conn);
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        active_[key]--;
+    }
+    slot_cv_.notify_all();
+}
+
+inline void ConnectionPool::add_created()
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    stats_.created++;
+}
+
+inline void ConnectionPool::close(Connection& conn)
+{
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+    if (conn.ssl) {
+        SSL_shutdown(conn.ssl);
+        SSL_free(conn.ssl);
+        conn.ssl = nullptr;
+    }
+#endif
+    if (conn.sock != INVALID_SOCKET) {
+        detail::close_socket(conn.sock);
+        conn.sock = INVALID_SOCKET;
+    }
+}
+
 /*
  * SSL Implementation
  */
@@ -2470,9 +3002,80 @@ inline bool SSLServer::read_and_close_socket(socket_t sock)
         });
 }
 
+// SSL session cache implementation
+inline SSLSessionCache::~SSLSessionCache()
+{
+    clear();
+}
+
+inline SSLSessionCacheStats SSLSessionCache::get_stats()
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto stats = stats_;
+    stats.sessions = sessions_.size();
+    return stats;
+}
+
+inline void SSLSessionCache::clear()
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (auto& it: sessions_) {
+        SSL_SESSION_free(it.second);
+    }
+    sessions_.clear();
+}
+
+inline SSL_SESSION* SSLSessionCache::get(const std::string& host)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = sessions_.find(host);
+    if (it == sessions_.end()) {
+        return nullptr;
+    }
+
+    SSL_SESSION_up_ref(it->second);
+    return it->second;
+}
+
+inline void SSLSessionCache::put(const std::string& host, SSL_SESSION* session)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = sessions_.find(host);
+    if (it != sessions_.end()) {
+        SSL_SESSION_free(it->second);
+        it->second = session;
+    } else {
+        sessions_[host] = session;
+    }
+}
+
+inline void SSLSessionCache::add_handshake(bool resumed)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (resumed) {
+        stats_.resumed++;
+    } else {
+        stats_.full++;
+    }
+}
+
+inline int SSLSessionCache::new_session_cb(SSL* ssl, SSL_SESSION* session)
+{
+    auto cache = static_cast<SSLSessionCache*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    auto host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    if (!cache || !host || !SSL_SESSION_is_resumable(session)) {
+        return 0;
+    }
+
+    // cache takes the reference to the session
+    cache->put(host, session);
+    return 1;
+}
+
 // SSL HTTP client implementation
 inline SSLClient::SSLClient(const char* host, int port, time_t timeout_sec)
     : Client(host, port, timeout_sec)
+    , session_cache_(nullptr)
 {
     ctx_ = SSL_CTX_new(SSLv23_client_method());
 }
@@ -2489,20 +3092,88 @@ inline bool SSLClient::is_valid() const
     return ctx_;
 }
 
+inline void SSLClient::set_session_cache(SSLSessionCache* cache)
+{
+    session_cache_ = cache;
+    if (ctx_) {
+        SSL_CTX_set_app_data(ctx_, cache);
+        SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx_, cache ? SSLSessionCache::new_session_cb : nullptr);
+    }
+}
+
+inline void SSLClient::setup_ssl(SSL* ssl)
+{
+    SSL_set_tlsext_host_name(ssl, host_.c_str());
+
+    if (session_cache_) {
+        auto session = session_cache_->get(host_);
+        if (session) {
+            SSL_set_session(ssl, session);
+            SSL_SESSION_free(session);
+        }
+    }
+}
+
+inline int SSLClient::connect_ssl(SSL* ssl)
+{
+    auto ret = SSL_connect(ssl);
+    if (ret == 1 && session_cache_) {
+        session_cache_->add_handshake(SSL_session_reused(ssl) == 1);
+    }
+    return ret;
+}
+
 inline bool SSLClient::read_and_close_socket(socket_t sock, Request& req, Response& res)
 {
     return is_valid() && detail::read_and_close_socket_ssl(
         sock, 0,
         ctx_, ctx_mutex_,
-        SSL_connect,
         [&](SSL* ssl) {
-            SSL_set_tlsext_host_name(ssl, host_.c_str());
+            return connect_ssl(ssl);
+        },
+        [&](SSL* ssl) {
+            setup_ssl(ssl);
         },
         [&](Stream& strm, bool /*last_connection*/, bool& connection_close) {
             return process_request(strm, req, res, connection_close);
         });
 }
 
+inline bool SSLClient::open_connection(ConnectionPool::Connection& conn)
+{
+    if (!is_valid() || !Client::open_connection(conn)) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(ctx_mutex_);
+        conn.ssl = SSL_new(ctx_);
+    }
+
+    if (!conn.ssl) {
+        ConnectionPool::close(conn);
+        return false;
+    }
+
+    auto bio = BIO_new_socket(conn.sock, BIO_NOCLOSE);
+    SSL_set_bio(conn.ssl, bio, bio);
+    setup_ssl(conn.ssl);
+
+    if (connect_ssl(conn.ssl) != 1) {
+        ConnectionPool::close(conn);
+        return false;
+    }
+
+    return true;
+}
+
+inline bool SSLClient::process_connection(ConnectionPool::Connection& conn, Request& req, Response& res, bool& connection_close)
+{
+    SSLSocketStream strm(conn.sock, conn.ssl);
+    return process_request(strm, req, res, connection_close);
+}
+
 inline bool SSLClient::is_ssl() const
 {
     return true;
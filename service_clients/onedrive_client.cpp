@@ -19,17 +19,32 @@ License along with this library; if not, write to the Free Software
 */
 
 #include <regex>
+#include <set>
+#include <thread>
 #include "onedrive_client.h"
+#include "segmented_download.h"
 #include "../plugin_utils.h"
 
 #include <iostream>
 
 #define CHUNK_SIZE 4000000
+#define FRAGMENT_ALIGN (320 * 1024) // upload session fragment must be multiple of 320 KiB
+#define FRAGMENT_SIZE (FRAGMENT_ALIGN * 10)
+#define MAX_FRAGMENT_SIZE (FRAGMENT_ALIGN * 192) // 60 MiB limit of one request
+
+// fragment size is doubled when it is sent faster and halved when it is sent slower, seconds
+#define FRAGMENT_FAST_TIME 2
+#define FRAGMENT_SLOW_TIME 10
+
+// throttled batch requests are sent again after Retry-After, seconds
+#define BATCH_RETRIES 3
+#define BATCH_MAX_RETRY_AFTER 30
 
 
 OneDriveClient::OneDriveClient()
 {
     m_http_client = new httplib::SSLClient("graph.microsoft.com");
+    setup_http_client(*m_http_client);
     m_client_id = "123";
 }
 
@@ -71,14 +86,13 @@ void OneDriveClient::set_oauth_token(const char *token)
     std::string header_token = "Bearer ";
     header_token += token;
     //std::cout << token;
-    m_headers = { {"Authorization", header_token}, {"Accept", "application/json"} };
+    _set_headers({ {"Authorization", header_token}, {"Accept", "application/json"} });
 }
 
 pResources OneDriveClient::get_resources(std::string path, BOOL isTrash)
 {
     std::string folderId("root"), folderName;
-    if (m_resourceNamesMap.find(path) != m_resourceNamesMap.end())
-        folderId = m_resourceNamesMap[path];
+    m_resourceNamesMap.get(path, folderId);
 
     std::string url;
     if(folderId == "root"){
@@ -86,19 +100,44 @@ pResources OneDriveClient::get_resources(std::string path, BOOL isTrash)
     } else {
         url = "/v1.0/me/drive/items/" + folderId + "/children";
     }
+    // only properties used in listing
+    url += "?$top=999&$select=id,name,size,folder,createdDateTime,lastModifiedDateTime,parentReference";
 
-    auto r = m_http_client->Get(url.c_str(), m_headers);
+    pResources pRes = new tResources;
+    pRes->nCount = 0;
 
-    if(r.get() && r->status==200){
-        const auto js = json::parse(r->body);
+    try{
+        while(!url.empty()){
+            auto r = m_http_client->Get(url.c_str(), _get_headers());
+            if(!r.get() || r->status!=200)
+                throw_response_error(r.get());
 
-        return prepare_folder_result(js, path);
-    } else {
-        throw_response_error(r.get());
+            json js = json::parse(r->body);
+            prepare_folder_result(js, pRes, path);
+
+            url.clear();
+            if(js["@odata.nextLink"].is_string())
+                url = _get_link_path(js["@odata.nextLink"].get<std::string>());
+        }
+    } catch(...){
+        delete pRes;
+        throw;
     }
+
+    return pRes;
 }
 
-pResources OneDriveClient::prepare_folder_result(json js, std::string &path)
+std::string OneDriveClient::_get_link_path(const std::string &link)
+{
+    // links are absolute urls with the same host
+    std::smatch m;
+    if (std::regex_search(link, m, std::regex("https://(.+?)(/.+)")))
+        return m[2].str();
+
+    throw std::runtime_error("Error parsing link: " + link);
+}
+
+void OneDriveClient::prepare_folder_result(json& js, pResources pRes, std::string &path)
 {
     if(!js["value"].is_array())
         throw std::runtime_error("Wrong Json format");
@@ -106,11 +145,9 @@ pResources OneDriveClient::prepare_folder_result(json js, std::string &path)
     BOOL isRoot = (path == "/");
     int total = js["value"].size();
 
-    pResources pRes = new tResources;
-    pRes->nCount = 0;
-    pRes->resource_array.resize(isRoot ? total+1: total);
+    int i = pRes->resource_array.size();
+    pRes->resource_array.resize(i + total);
 
-    int i=0;
     for(auto& item: js["value"]){
         wcharstring wName = UTF8toUTF16(item["name"].get<std::string>());
 
@@ -126,10 +163,9 @@ pResources OneDriveClient::prepare_folder_result(json js, std::string &path)
         } else {
             pRes->resource_array[i].dwFileAttributes = 0;
             if(item["size"].is_number())
-                pRes->resource_array[i].nFileSizeLow = (DWORD) item["size"].get<int>();
+                set_file_size(pRes->resource_array[i], item["size"].get<uint64_t>());
             else
-                pRes->resource_array[i].nFileSizeLow = (DWORD) 0;
-            pRes->resource_array[i].nFileSizeHigh = 0;
+                set_file_size(pRes->resource_array[i], 0);
             pRes->resource_array[i].ftCreationTime = parse_iso_time(item["createdDateTime"].get<std::string>());
             pRes->resource_array[i].ftLastWriteTime = parse_iso_time(item["lastModifiedDateTime"].get<std::string>());
         }
@@ -138,17 +174,15 @@ pResources OneDriveClient::prepare_folder_result(json js, std::string &path)
         if(path != "/")
             p += "/";
         p += item["name"].get<std::string>();
-        m_resourceNamesMap[p] = item["id"].get<std::string>();
+        m_resourceNamesMap.put(p, item["id"].get<std::string>());
 
         i++;
     }
 
     // get root folder id
-    if(isRoot && total > 0 && m_resourceNamesMap.find("/") == m_resourceNamesMap.end()){
-        m_resourceNamesMap["/"] = js["value"][0]["parentReference"]["id"];
+    if(isRoot && total > 0){
+        m_resourceNamesMap.put_if_absent("/", js["value"][0]["parentReference"]["id"].get<std::string>());
     }
-
-    return pRes;
 }
 
 void OneDriveClient::makeFolder(std::string utf8Path)
@@ -158,8 +192,7 @@ void OneDriveClient::makeFolder(std::string utf8Path)
     folderName = utf8Path.substr(p + 1);
     if(p>0){
         std::string parentFolderPath = utf8Path.substr(0, p);
-        if(m_resourceNamesMap.find(parentFolderPath) != m_resourceNamesMap.end())
-            parentFolderId = m_resourceNamesMap[parentFolderPath];
+        m_resourceNamesMap.get(parentFolderPath, parentFolderId);
     }
 
     std::string url;
@@ -177,14 +210,14 @@ void OneDriveClient::makeFolder(std::string utf8Path)
 
     std::cout << jsBody.dump();
 
-    httplib::Headers hd = m_headers;
+    httplib::Headers hd = _get_headers();
     hd.emplace("Content-Type", "application/json");
 
     auto r = m_http_client->Post(url.c_str(), hd, jsBody.dump(), "application/json");
 
     if(r.get() && r->status==201){
         json js = json::parse(r->body);
-        m_resourceNamesMap[utf8Path] = js["id"].get<std::string>();
+        m_resourceNamesMap.put(utf8Path, js["id"].get<std::string>());
     } else {
         throw_response_error(r.get());
     }
@@ -192,28 +225,28 @@ void OneDriveClient::makeFolder(std::string utf8Path)
 
 void OneDriveClient::removeResource(std::string utf8Path)
 {
-    if(m_resourceNamesMap.find(utf8Path) == m_resourceNamesMap.end())
+    if(!m_resourceNamesMap.contains(utf8Path))
         throw std::runtime_error("resource ID not found");
 
     std::string url("/v1.0/me/drive/items/");
-    url += m_resourceNamesMap[utf8Path];
-    auto r = m_http_client->Delete(url.c_str(), m_headers);
+    url += m_resourceNamesMap.get(utf8Path);
+    auto r = m_http_client->Delete(url.c_str(), _get_headers());
 
     if(!r.get() || r->status!=204){
         throw_response_error(r.get());
     }
 }
 
-void OneDriveClient::downloadFile(std::string path, std::ofstream &ofstream, std::string localPath)
+void OneDriveClient::downloadFile(std::string path, std::ofstream &ofstream, std::string localPath, uint64_t offset, TransferProgress* progress)
 {
-    if(m_resourceNamesMap.find(path) == m_resourceNamesMap.end())
+    if(!m_resourceNamesMap.contains(path))
         throw std::runtime_error("resource ID not found");
 
     std::string url("/v1.0/me/drive/items/");
-    url += m_resourceNamesMap[path];
+    url += m_resourceNamesMap.get(path);
     url += "/content";
 
-    auto r = m_http_client->Get(url.c_str(), m_headers);
+    auto r = m_http_client->Get(url.c_str(), _get_headers());
     if(r.get() && r->status==302){
         url = r->get_header_value("Location");
 
@@ -228,43 +261,39 @@ void OneDriveClient::downloadFile(std::string path, std::ofstream &ofstream, std
             throw std::runtime_error("Error parsing file href for download");
         }
 
-        // TODO download big file by parts with range header
-        httplib::SSLClient cli2(server_url.c_str());
-        auto r2 = cli2.Get(request_url.c_str());
+        SegmentedDownload download(server_url, 443, request_url, httplib::Headers());
+        download.set_segments(m_download_segments);
+        download.set_segment_size(_get_download_segment_size());
+        download.set_progress(progress);
+        download.set_connection_pool(&m_connection_pool);
 
-        if(r2.get() && r2->status == 200){
-            ofstream.write(r2->body.data(), r2->body.size());
-        } else {
+        auto r2 = download.run(ofstream, localPath, offset);
+
+        if(!r2.get() || (r2->status != 200 && r2->status != 206)){
             throw_response_error(r2.get());
         }
     }
 }
 
-void OneDriveClient::uploadFile(std::string path, std::ifstream &ifstream, BOOL overwrite)
+void OneDriveClient::uploadFile(std::string path, UploadSource &source, BOOL overwrite, BOOL resume)
 {
-    ifstream.seekg(0, ifstream.end);
-    int fileSize = ifstream.tellg();
-    ifstream.seekg(0, ifstream.beg);
+    int64_t fileSize = source.size();
 
-    if(fileSize < CHUNK_SIZE){ // use upload_session/start for files more than 150Mb
-        _upload_small_file(path, ifstream, overwrite);
+    if(fileSize < CHUNK_SIZE){ // use upload session for files more than 4Mb
+        _upload_small_file(path, source, overwrite, fileSize);
     } else {
-        _upload_big_file(path, ifstream, overwrite, fileSize);
+        _upload_big_file(path, source, overwrite, fileSize, resume);
     }
 }
 
-void OneDriveClient::_upload_small_file(std::string& path, std::ifstream &ifstream, BOOL overwrite)
+void OneDriveClient::_upload_small_file(std::string& path, UploadSource &source, BOOL overwrite, int64_t fileSize)
 {
-    std::stringstream body;
-    body << ifstream.rdbuf();
-
     std::string fileName, parentFolderId("root");
     int p = path.find_last_of('/');
     fileName = path.substr(p + 1);
     if(p>0){
         std::string parentFolderPath = path.substr(0, p);
-        if(m_resourceNamesMap.find(parentFolderPath) != m_resourceNamesMap.end())
-            parentFolderId = m_resourceNamesMap[parentFolderPath];
+        m_resourceNamesMap.get(parentFolderPath, parentFolderId);
     }
 
     std::string url("/v1.0/me/drive/items/");
@@ -273,7 +302,9 @@ void OneDriveClient::_upload_small_file(std::string& path, std::ifstream &ifstre
     url += url_encode(fileName);
     url += ":/content";
 
-    auto r = m_http_client->Put(url.c_str(), m_headers, body.str(), "application/octet-stream");
+    auto r = m_http_client->Put(url.c_str(), _get_headers(), fileSize, source.provider(0), "application/octet-stream");
+    if(source.is_cancelled())
+        throw transfer_cancelled_exception();
 
     if(r.get() && r->status == 201){
         return;
@@ -283,91 +314,565 @@ void OneDriveClient::_upload_small_file(std::string& path, std::ifstream &ifstre
 
 }
 
-void OneDriveClient::_upload_big_file(std::string& path, std::ifstream &ifstream, BOOL overwrite, int fileSize)
+void OneDriveClient::_upload_big_file(std::string& path, UploadSource &source, BOOL overwrite, int64_t fileSize, BOOL resume)
+{
+    std::string uploadUrl;
+    int64_t offset = 0;
+
+    json session = resume ? _get_upload_session(path) : json();
+    if(session.is_object() && session["size"] == fileSize){
+        uploadUrl = session["url"].get<std::string>();
+        offset = _get_upload_offset(uploadUrl);
+        if(offset < 0) // session has expired, start new one
+            uploadUrl.clear();
+    }
+
+    if(uploadUrl.empty()){
+        uploadUrl = _create_upload_session(path, overwrite);
+        offset = 0;
+        _save_upload_session(path, { {"url", uploadUrl}, {"size", fileSize} });
+    }
+
+    std::string server_url, request_url;
+    std::smatch m;
+    auto pattern = std::regex("https://(.+?)(/.+)");
+    if (std::regex_search(uploadUrl, m, pattern)) {
+        server_url = m[1].str();
+        request_url = m[2].str();
+    } else {
+        throw std::runtime_error("Error parsing file href for upload");
+    }
+
+    // upload url is preauthenticated, Authorization header must not be sent
+    httplib::SSLClient cli(server_url.c_str());
+    setup_http_client(cli);
+
+    // configured chunk size limits the adaptive fragment size
+    int64_t maxFragmentSize = std::min<int64_t>(_get_upload_chunk_size(), MAX_FRAGMENT_SIZE);
+    maxFragmentSize = std::max<int64_t>(maxFragmentSize - maxFragmentSize % FRAGMENT_ALIGN, FRAGMENT_ALIGN);
+    int64_t fragmentSize = std::min<int64_t>(FRAGMENT_SIZE, maxFragmentSize);
+    int failures = 0;
+
+    while(offset < fileSize){
+        if(source.get_progress())
+            source.get_progress()->set_done(offset);
+
+        int64_t length = std::min<int64_t>(fragmentSize, fileSize - offset);
+
+        // next fragment is read from disk while the current one is sent
+        source.prefetch(offset, length + fragmentSize);
+
+        httplib::Headers hd;
+        hd.emplace("Content-Range", "bytes " + std::to_string(offset) + "-" + std::to_string(offset + length - 1) + "/" + std::to_string(fileSize));
+
+        auto started = std::chrono::steady_clock::now();
+        auto r = cli.Put(request_url.c_str(), hd, length, source.provider(offset), "application/octet-stream");
+        auto elapsed = std::chrono::steady_clock::now() - started;
+
+        // cancelled upload session is removed on server
+        if(source.is_cancelled()){
+            cli.Delete(request_url.c_str());
+            _remove_upload_session(path);
+            throw transfer_cancelled_exception();
+        }
+
+        if(r.get() && (r->status == 200 || r->status == 201)){
+            _remove_upload_session(path);
+            return;
+        }
+
+        if(r.get() && r->status == 202){
+            offset += length;
+            json js = json::parse(r->body);
+            if(js["nextExpectedRanges"].is_array() && js["nextExpectedRanges"].size() > 0)
+                offset = std::stoll(js["nextExpectedRanges"][0].get<std::string>());
+
+            failures = 0;
+            if(length == fragmentSize && elapsed < std::chrono::seconds(FRAGMENT_FAST_TIME))
+                fragmentSize = std::min(fragmentSize * 2, maxFragmentSize);
+            else if(elapsed > std::chrono::seconds(FRAGMENT_SLOW_TIME))
+                fragmentSize = std::max<int64_t>(fragmentSize / 2 - (fragmentSize / 2) % FRAGMENT_ALIGN, FRAGMENT_ALIGN);
+
+            continue;
+        }
+
+        if(r.get() && r->status == 404){
+            _remove_upload_session(path);
+            throw service_client_exception(404, "The upload session has expired");
+        }
+
+        // fragment is repeated from the offset expected by server
+        if((!r.get() || r->status >= 500 || r->status == 429) && ++failures < UPLOAD_CHUNK_RETRIES){
+            int delay = 1 << failures;
+            if(r.get() && r->has_header("Retry-After"))
+                delay = std::atoi(r->get_header_value("Retry-After").c_str());
+            std::this_thread::sleep_for(std::chrono::seconds(delay));
+
+            fragmentSize = std::max<int64_t>(fragmentSize / 2 - (fragmentSize / 2) % FRAGMENT_ALIGN, FRAGMENT_ALIGN);
+            offset = _get_upload_offset(uploadUrl);
+            if(offset < 0){
+                _remove_upload_session(path);
+                throw service_client_exception(404, "The upload session has expired");
+            }
+
+            continue;
+        }
+
+        throw_response_error(r.get());
+    }
+}
+
+std::string OneDriveClient::_create_upload_session(std::string& path, BOOL overwrite)
 {
     std::string fileName, parentFolderId("root");
     int p = path.find_last_of('/');
     fileName = path.substr(p + 1);
     if(p>0){
         std::string parentFolderPath = path.substr(0, p);
-        if(m_resourceNamesMap.find(parentFolderPath) != m_resourceNamesMap.end())
-            parentFolderId = m_resourceNamesMap[parentFolderPath];
+        m_resourceNamesMap.get(parentFolderPath, parentFolderId);
     }
 
     std::string url("/v1.0/me/drive/items/");
     url += parentFolderId;
     url += ":/";
-    url += fileName;
+    url += url_encode(fileName);
     url += ":/createUploadSession";
 
-    json jsParams = { {"item", {"@microsoft.graph.conflictBehavior", "rename"} } };
-    auto r = m_http_client->Post("/2/files/upload_session/start", m_headers, jsParams.dump(), "application/json");
+    json jsParams = { {"item", { {"@microsoft.graph.conflictBehavior", (overwrite ? "replace" : "fail")} } } };
+    auto r = m_http_client->Post(url.c_str(), _get_headers(), jsParams.dump(), "application/json");
 
-    std::string uploadUrl;
-    if(r.get() && r->status == 200) {
-        json js = json::parse(r->body);
-        uploadUrl = js["uploadUrl"].get<std::string>();
-    } else {
+    if(!r.get() || r->status != 200)
         throw_response_error(r.get());
-    }
 
+    json js = json::parse(r->body);
+    return js["uploadUrl"].get<std::string>();
+}
+
+int64_t OneDriveClient::_get_upload_offset(std::string& uploadUrl)
+{
     std::string server_url, request_url;
     std::smatch m;
     auto pattern = std::regex("https://(.+?)(/.+)");
-    if (std::regex_search(url, m, pattern)) {
+    if (std::regex_search(uploadUrl, m, pattern)) {
         server_url = m[1].str();
         request_url = m[2].str();
     } else {
-        throw std::runtime_error("Error parsing file href for upload");
+        throw std::runtime_error("Error parsing upload session url");
     }
 
     httplib::SSLClient cli(server_url.c_str());
-    httplib::Headers hd; // = m_headers;
-    int count = fileSize / CHUNK_SIZE + ((fileSize % CHUNK_SIZE) > 0 ? 1 : 0);
-    int offset = 0, c = 0;
+    setup_http_client(cli);
+    auto r = cli.Get(request_url.c_str());
+
+    if(r.get() && r->status == 404)
+        return -1;
+
+    if(!r.get() || r->status != 200)
+        throw_response_error(r.get());
+
+    json js = json::parse(r->body);
+    if(!js["nextExpectedRanges"].is_array() || js["nextExpectedRanges"].size() == 0)
+        return 0;
+
+    return std::stoll(js["nextExpectedRanges"][0].get<std::string>());
+}
+
+json OneDriveClient::get_metadata()
+{
+    return { {"ids", m_resourceNamesMap.snapshot()} };
+}
+
+void OneDriveClient::set_metadata(const json &metadata)
+{
+    auto ids = metadata.find("ids");
+    if(ids != metadata.end() && ids->is_object()){
+        for(auto it = ids->begin(); it != ids->end(); ++it)
+            m_resourceNamesMap.put(it.key(), it.value().get<std::string>());
+    }
+}
 
-    std::string body;
-    body.reserve(CHUNK_SIZE);
-    body.resize(CHUNK_SIZE);
+json OneDriveClient::get_changes(const std::string &cursor)
+{
+    if(cursor.empty()){
+        // root ID is needed to find changes in the root folder
+        auto r = m_http_client->Get("/v1.0/me/drive/root?$select=id", _get_headers());
+        if(!r.get() || r->status != 200)
+            throw_response_error(r.get());
+        m_resourceNamesMap.put("/", json::parse(r->body)["id"].get<std::string>());
 
-    while(count >= 0){
+        r = m_http_client->Get("/v1.0/me/drive/root/delta?token=latest", _get_headers());
+        if(!r.get() || r->status != 200)
+            throw_response_error(r.get());
 
-        hd.emplace("Content-Length", std::to_string((count == 0 ? fileSize - offset : CHUNK_SIZE)) );
-        int rest = (count == 0 ? fileSize - 1 : c * offset + CHUNK_SIZE - 1);
+        json js = json::parse(r->body);
+        if(!js["@odata.deltaLink"].is_string())
+            throw std::runtime_error("Wrong Json format");
 
-        std::stringstream range;
-        range << "bytes" << c * offset << "-" << rest << "/" << fileSize;
+        return { {"cursor", _get_link_path(js["@odata.deltaLink"].get<std::string>())}, {"paths", json::array()} };
+    }
 
-        hd.erase("Content-Range");
-        hd.emplace("Content-Range", range.str());
+    std::map<std::string, std::string> paths;
+    for(auto& it: m_resourceNamesMap.snapshot())
+        paths[it.second] = it.first;
 
-        ifstream.read(&body[0], (count == 0 ? fileSize - offset : CHUNK_SIZE));
+    json result = { {"paths", json::array()} };
+    std::string url = cursor;
+
+    while(true){
+        auto r = m_http_client->Get(url.c_str(), _get_headers());
+        if(r.get() && r->status == 410){ // resync required
+            json js = get_changes("");
+            js["reset"] = true;
+            return js;
+        }
+
+        if(!r.get() || r->status != 200)
+            throw_response_error(r.get());
+
+        json js = json::parse(r->body);
+        for(auto& item: js["value"]){
+            // previous location of the item
+            auto it = paths.find(item["id"].get<std::string>());
+            if(it != paths.end())
+                result["paths"].push_back(it->second);
+
+            // new location
+            if(item["parentReference"].is_object() && item["parentReference"]["id"].is_string() && item["name"].is_string()){
+                it = paths.find(item["parentReference"]["id"].get<std::string>());
+                if(it != paths.end())
+                    result["paths"].push_back((it->second == "/" ? "" : it->second) + "/" + item["name"].get<std::string>());
+            }
+        }
+
+        if(js["@odata.deltaLink"].is_string()){
+            result["cursor"] = _get_link_path(js["@odata.deltaLink"].get<std::string>());
+            return result;
+        }
+
+        if(!js["@odata.nextLink"].is_string())
+            throw std::runtime_error("Wrong Json format");
+
+        url = _get_link_path(js["@odata.nextLink"].get<std::string>());
+    }
+}
+
+void OneDriveClient::run_batch(std::vector<BatchOperation>& operations)
+{
+    size_t start = 0;
+    while(start < operations.size()){
+        // copy continues on the server after response, so delete related to it goes to the next call
+        size_t end = start + 1;
+        while(end < operations.size() && end - start < ONEDRIVE_BATCH_LIMIT){
+            bool afterCopy = false;
+            for(size_t i=start; i<end && operations[end].type == "delete" && !afterCopy; i++)
+                afterCopy = operations[i].type == "copy" && is_related_path(operations[end].from, operations[i].from);
+            if(afterCopy)
+                break;
+            end++;
+        }
+
+        // results of previous calls are known here
+        _skip_deletes(operations, start, end);
+        _run_batch(operations, start, end);
+
+        start = end;
+    }
+}
+
+void OneDriveClient::_run_batch(std::vector<BatchOperation>& operations, size_t start, size_t end)
+{
+    // request id is index of operation
+    std::map<std::string, json> requests;
+    for(size_t i=start; i<end; i++){
+        if(!operations[i].error.empty())
+            continue;
+
+        json request;
+        std::string error;
+        if(!_get_batch_request(operations[i], request, error)){
+            operations[i].error = error;
+            continue;
+        }
+
+        request["id"] = std::to_string(i);
+
+        // operation on the path of previous ones, or on something inside it, waits for them
+        json dependsOn = json::array();
+        for(size_t j=start; j<i; j++){
+            if(requests.count(std::to_string(j)) &&
+               (is_related_path(operations[j].from, operations[i].from) || is_related_path(operations[j].from, operations[i].to)
+                || is_related_path(operations[j].to, operations[i].from) || is_related_path(operations[j].to, operations[i].to)))
+                dependsOn.push_back(std::to_string(j));
+        }
+        if(!dependsOn.empty())
+            request["dependsOn"] = dependsOn;
+
+        requests[request["id"].get<std::string>()] = request;
+    }
+
+    // accepted copies, checked together after all calls
+    std::map<size_t, std::future<json>> copies;
+
+    for(int attempt=1; !requests.empty(); attempt++){
+        json jsBody;
+        jsBody["requests"] = json::array();
+        for(auto& it: requests)
+            jsBody["requests"].push_back(it.second);
+
+        auto r = m_http_client->Post("/v1.0/$batch", _get_headers(), jsBody.dump(), "application/json");
+        if(!r.get() || r->status!=200){
+            std::string message = r.get() ? _get_batch_error(r->status, json::parse(r->body, nullptr, false)) : "Unknown error";
+            for(auto& it: requests)
+                operations[std::stoul(it.first)].error = message;
+            break;
+        }
+
+        int retryAfter = 0;
+        std::map<std::string, json> retry;
+        std::map<std::string, json> failedDependency;
+        json js = json::parse(r->body, nullptr, false);
+        if(js.is_discarded() || !js.is_object() || !js["responses"].is_array()){
+            for(auto& it: requests)
+                operations[std::stoul(it.first)].error = "Error parsing batch response";
+            break;
+        }
+
+        std::set<std::string> answered;
+        for(auto& response: js["responses"]){
+            if(!response.is_object() || !response["id"].is_string() || !response["status"].is_number_integer())
+                continue;
+
+            std::string id = response["id"].get<std::string>();
+            if(!requests.count(id))
+                continue;
+            answered.insert(id);
+
+            BatchOperation& operation = operations[std::stoul(id)];
+            int status = response["status"].get<int>();
+
+            if(status >= 200 && status < 300){
+                if(operation.type == "move")
+                    m_resourceNamesMap.put(operation.to, m_resourceNamesMap.get(operation.from));
+
+                // copy is accepted and continues on the server, its monitor url is checked
+                if(operation.type == "copy" && status == 202){
+                    try{
+                        json& headers = response["headers"];
+                        std::string location = headers.is_object() ? headers.value("Location", headers.value("location", "")) : "";
+                        if(location.empty())
+                            throw std::runtime_error("Copy status url is not received");
+                        copies[std::stoul(id)] = _track_copy(location);
+                    } catch (std::exception & e){
+                        operation.error = e.what();
+                    }
+                }
+                continue;
+            }
+
+            // already deleted, i.e. together with its folder
+            if(operation.type == "delete" && status == 404)
+                continue;
+
+            if((status == 429 || status == 503 || status == 504) && attempt < BATCH_RETRIES){
+                // unparsable Retry-After falls back to 1 second
+                if(response["headers"].is_object() && response["headers"]["Retry-After"].is_string())
+                    retryAfter = std::max(retryAfter, std::max(std::atoi(response["headers"]["Retry-After"].get<std::string>().c_str()), 1));
+                retry[id] = requests[id];
+                continue;
+            }
+
+            if(status == 424){
+                failedDependency[id] = response["body"];
+                continue;
+            }
+
+            operation.error = _get_batch_error(status, response["body"]);
+        }
+
+        // operation without a response is not known to be done
+        for(auto& it: requests){
+            if(!answered.count(it.first))
+                operations[std::stoul(it.first)].error = "Unknown error";
+        }
 
-        r = cli.Put(request_url.c_str(), hd, body, "application/octet-stream");
+        // request is sent again together with the throttled one it waits for
+        bool added = true;
+        while(added){
+            added = false;
+            for(auto it = failedDependency.begin(); it != failedDependency.end();){
+                bool waitsForRetry = false;
+                for(auto& dependency: requests[it->first].value("dependsOn", json::array()))
+                    waitsForRetry = waitsForRetry || retry.count(dependency.get<std::string>());
+
+                if(waitsForRetry && attempt < BATCH_RETRIES){
+                    retry[it->first] = requests[it->first];
+                    it = failedDependency.erase(it);
+                    added = true;
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        // dependency failed for good, operation was not run
+        for(auto& it: failedDependency)
+            operations[std::stoul(it.first)].error = _get_batch_error(424, it.second);
+
+        // dependencies on completed requests are dropped
+        for(auto& it: retry){
+            if(it.second.find("dependsOn") == it.second.end())
+                continue;
+
+            json dependsOn = json::array();
+            for(auto& dependency: it.second["dependsOn"]){
+                if(retry.count(dependency.get<std::string>()))
+                    dependsOn.push_back(dependency);
+            }
+            if(dependsOn.empty())
+                it.second.erase("dependsOn");
+            else
+                it.second["dependsOn"] = dependsOn;
+        }
+
+        requests.swap(retry);
+        if(!requests.empty())
+            std::this_thread::sleep_for(std::chrono::seconds(std::min(std::max(retryAfter, 1), BATCH_MAX_RETRY_AFTER)));
+    }
+
+    for(auto& it: copies){
+        BatchOperation& operation = operations[it.first];
+        try{
+            json result = it.second.get();
+            if(result["resourceId"].is_string())
+                m_resourceNamesMap.put(operation.to, result["resourceId"].get<std::string>());
+        } catch (std::exception & e){
+            operation.error = e.what();
+        }
+    }
+}
+
+std::future<json> OneDriveClient::_track_copy(const std::string& monitorUrl)
+{
+    std::smatch m;
+    if(!std::regex_search(monitorUrl, m, std::regex("https://(.+?)(/.+)")))
+        throw std::runtime_error("Error parsing copy status url");
+
+    // monitor url does not need authorization
+    std::string host = m[1].str();
+    std::string path = m[2].str();
+    httplib::ConnectionPool* pool = &m_connection_pool;
+
+    return get_operation_poller().add([host, path, pool](json& result){
+        httplib::SSLClient cli(host.c_str());
+        setup_http_client(cli, pool);
+
+        auto r = cli.Get(path.c_str());
+        if(!r.get())
+            throw std::runtime_error("Error getting copy status");
+
+        // finished copy is redirected to the new item
+        if(r->status == 303){
+            result = json::object();
+            return true;
+        }
+
+        if(r->status != 200 && r->status != 202)
+            throw service_client_exception(r->status, "Error getting copy status");
+
+        result = json::parse(r->body);
+        std::string status = result["status"].is_string() ? result["status"].get<std::string>() : "";
+        if(status == "failed"){
+            std::string message = "Copy error";
+            if(result["error"].is_object() && result["error"]["message"].is_string())
+                message += ": " + result["error"]["message"].get<std::string>();
+            throw service_client_exception(500, message);
+        }
+
+        return status == "completed";
+    }, ONEDRIVE_COPY_TIMEOUT);
+}
+
+bool OneDriveClient::_get_batch_request(const BatchOperation& operation, json& request, std::string& error)
+{
+    std::string fileId;
+    if(!m_resourceNamesMap.get(operation.from, fileId)){
+        error = "Cannot find file ID";
+        return false;
+    }
+
+    // urls are relative to the api version
+    request["url"] = "/me/drive/items/" + fileId;
+    if(operation.type == "delete"){
+        request["method"] = "DELETE";
+        return true;
+    }
+
+    if(operation.type != "move" && operation.type != "copy"){
+        error = "Unknown batch operation: " + operation.type;
+        return false;
+    }
+
+    int p = operation.to.find_last_of('/');
+    std::string toFolderId;
+    if(!m_resourceNamesMap.get(p > 0 ? operation.to.substr(0, p) : "/", toFolderId) && p > 0){
+        error = "Cannot find folder ID";
+        return false;
+    }
+
+    json jsParams;
+    jsParams["parentReference"]["id"] = toFolderId;
+    jsParams["name"] = operation.to.substr(p + 1);
+
+    // same calls as move and copy do one by one
+    if(operation.type == "move"){
+        request["method"] = "PATCH";
+    } else {
+        request["method"] = "POST";
+        request["url"] = request["url"].get<std::string>() + "/copy";
+    }
+    request["body"] = jsParams;
+    request["headers"] = { {"Content-Type", "application/json"} };
+
+    return true;
+}
+
+std::string OneDriveClient::_get_batch_error(int status, const json& body)
+{
+    // the same results as FS_FILE_* codes of one by one operations
+    std::string result;
+    switch(status){
+        case 404: result = "File not found"; break;
+        case 409:
+        case 412: result = "File exists"; break;
+        case 424: result = "Previous operation on this file failed"; break;
+        default: result = "Error code: " + std::to_string(status);
+    }
 
-        offset += CHUNK_SIZE;
-        count --;
-        c++;
+    if(body.is_object() && body.find("error") != body.end() && body.at("error").is_object()){
+        const json& error = body.at("error");
+        if(error.find("message") != error.end() && error.at("message").is_string())
+            result += "; " + error.at("message").get<std::string>();
     }
 
+    return result;
 }
 
 void OneDriveClient::move(std::string from, std::string to, BOOL overwrite)
 {
     std::string fileId, newParentId;
-    if(m_resourceNamesMap.find(from) == m_resourceNamesMap.end())
+    if(!m_resourceNamesMap.contains(from))
         throw std::runtime_error("Cannot find file ID");
 
-    fileId = m_resourceNamesMap[from];
+    fileId = m_resourceNamesMap.get(from);
 
     int p = to.find_last_of('/');
     std::string toFileName = to.substr(p + 1);
     if(p>0){
         std::string newParentPath = to.substr(0, p);
-        if(m_resourceNamesMap.find(newParentPath) == m_resourceNamesMap.end())
+        if(!m_resourceNamesMap.contains(newParentPath))
             throw std::runtime_error("Cannot find folder ID");
 
-        newParentId = m_resourceNamesMap[newParentPath];
+        newParentId = m_resourceNamesMap.get(newParentPath);
     }
 
     std::string url("/v1.0/me/drive/items/");
@@ -377,7 +882,7 @@ void OneDriveClient::move(std::string from, std::string to, BOOL overwrite)
     jsParams["parentReference"]["id"] = newParentId;
     jsParams["name"] = toFileName;
 
-    auto r = m_http_client->Patch(url.c_str(), m_headers, jsParams.dump(), "application/json");
+    auto r = m_http_client->Patch(url.c_str(), _get_headers(), jsParams.dump(), "application/json");
 
     if(!r.get() || r->status!=200)
         throw_response_error(r.get());
@@ -386,19 +891,19 @@ void OneDriveClient::move(std::string from, std::string to, BOOL overwrite)
 void OneDriveClient::copy(std::string from, std::string to, BOOL overwrite)
 {
     std::string fileId, toFileName, toFolderId;
-    if(m_resourceNamesMap.find(from) == m_resourceNamesMap.end())
+    if(!m_resourceNamesMap.contains(from))
         throw std::runtime_error("Cannot find file ID");
 
-    fileId = m_resourceNamesMap[from];
+    fileId = m_resourceNamesMap.get(from);
 
     int p = to.find_last_of('/');
     toFileName = to.substr(p + 1);
     if(p>0){
         std::string newFolderPath = to.substr(0, p);
-        if(m_resourceNamesMap.find(newFolderPath) == m_resourceNamesMap.end())
+        if(!m_resourceNamesMap.contains(newFolderPath))
             throw std::runtime_error("Cannot find folder ID");
 
-        toFolderId = m_resourceNamesMap[newFolderPath];
+        toFolderId = m_resourceNamesMap.get(newFolderPath);
     }
 
     std::string url("/v1.0/me/drive/items/");
@@ -409,7 +914,7 @@ void OneDriveClient::copy(std::string from, std::string to, BOOL overwrite)
     jsParams["parentReference"]["id"] = toFolderId;
     jsParams["name"] = toFileName;
 
-    auto r = m_http_client->Post(url.c_str(), m_headers, jsParams.dump(), "application/json");
+    auto r = m_http_client->Post(url.c_str(), _get_headers(), jsParams.dump(), "application/json");
 
     if(!r.get() || r->status!=202)
         throw_response_error(r.get());
@@ -23,9 +23,15 @@ License along with this library; if not, write to the Free Software
 
 #define CPPHTTPLIB_OPENSSL_SUPPORT
 #include "service_client.h"
+#include "path_map.h"
 #include "httplib.h"
 #include "../library.h"
 
+// max requests in one call of Graph /$batch
+#define ONEDRIVE_BATCH_LIMIT 20
+// seconds to wait for accepted copy
+#define ONEDRIVE_COPY_TIMEOUT 300
+
 class OneDriveClient: public ServiceClient {
 public:
     OneDriveClient();
@@ -45,9 +51,9 @@ public:
 
     void removeResource(std::string utf8Path);
 
-    void downloadFile(std::string path, std::ofstream &ofstream, std::string localPath);
+    void downloadFile(std::string path, std::ofstream &ofstream, std::string localPath, uint64_t offset, TransferProgress* progress);
 
-    void uploadFile(std::string path, std::ifstream &ifstream, BOOL overwrite);
+    void uploadFile(std::string path, UploadSource &source, BOOL overwrite, BOOL resume);
 
     void move(std::string from, std::string to, BOOL overwrite);
 
@@ -63,17 +69,37 @@ public:
 
     void run_command(std::string remoteName, std::vector<std::string> &arguments) {}
 
+    json get_metadata();
+
+    void set_metadata(const json& metadata);
+
+    json get_changes(const std::string& cursor);
+
+    size_t get_batch_limit() { return ONEDRIVE_BATCH_LIMIT; }
+
+    void run_batch(std::vector<BatchOperation>& operations);
+
 private:
     std::string token;
     httplib::SSLClient* m_http_client;
-    httplib::Headers m_headers;
 
-    std::map<std::string, std::string> m_resourceNamesMap;
+    PathMap m_resourceNamesMap;
 
     void throw_response_error(httplib::Response* resp);
-    pResources prepare_folder_result(json json, std::string& path);
-    void _upload_small_file(std::string& path, std::ifstream &ifstream, BOOL overwrite);
-    void _upload_big_file(std::string& path, std::ifstream &ifstream, BOOL overwrite, int fileSize);
+    void prepare_folder_result(json& js, pResources pRes, std::string& path);
+    std::string _get_link_path(const std::string& link);
+    void _upload_small_file(std::string& path, UploadSource &source, BOOL overwrite, int64_t fileSize);
+    void _upload_big_file(std::string& path, UploadSource &source, BOOL overwrite, int64_t fileSize, BOOL resume);
+    std::string _create_upload_session(std::string& path, BOOL overwrite);
+    // returns -1 if upload session has expired
+    int64_t _get_upload_offset(std::string& uploadUrl);
+
+    void _run_batch(std::vector<BatchOperation>& operations, size_t start, size_t end);
+    // status of copy from the monitor url of 202 response
+    std::future<json> _track_copy(const std::string& monitorUrl);
+    // request of the batch, returns false and sets error if item ID is unknown
+    bool _get_batch_request(const BatchOperation& operation, json& request, std::string& error);
+    std::string _get_batch_error(int status, const json& body);
 };
 
 
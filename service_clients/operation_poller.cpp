@@ -0,0 +1,131 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#include <algorithm>
+#include "operation_poller.h"
+
+OperationPoller::~OperationPoller()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+
+    for(auto& worker: m_workers)
+        worker.join();
+}
+
+std::future<json> OperationPoller::add(Check check, int timeout)
+{
+    auto now = std::chrono::steady_clock::now();
+    auto operation = std::make_shared<Operation>();
+    operation->check = check;
+    operation->interval = std::chrono::milliseconds(POLL_MIN_INTERVAL);
+    operation->next = now + operation->interval;
+    operation->deadline = now + std::chrono::seconds(timeout);
+
+    std::future<json> future = operation->promise.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_operations.push_back(operation);
+
+        // started on first use
+        if(m_workers.empty()){
+            for(int i=0; i<POLL_WORKERS; i++)
+                m_workers.emplace_back(&OperationPoller::_work, this);
+        }
+    }
+    m_cv.notify_all();
+
+    return future;
+}
+
+void OperationPoller::_work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while(!m_stop){
+        // the earliest operation which is not being checked by another worker
+        auto now = std::chrono::steady_clock::now();
+        std::shared_ptr<Operation> due;
+        auto next = std::chrono::steady_clock::time_point::max();
+        for(auto& operation: m_operations){
+            if(operation->checking)
+                continue;
+
+            if(operation->next <= now && (!due || operation->next < due->next))
+                due = operation;
+            else if(operation->next > now)
+                next = std::min(next, operation->next);
+        }
+
+        if(!due){
+            if(next == std::chrono::steady_clock::time_point::max())
+                m_cv.wait(lock);
+            else
+                m_cv.wait_until(lock, next);
+            continue;
+        }
+
+        due->checking = true;
+        lock.unlock();
+        bool finished = _check(*due);
+        lock.lock();
+
+        due->checking = false;
+        if(finished)
+            m_operations.remove(due);
+    }
+
+    // nobody waits for the rest at exit, operations being checked are left to their workers
+    m_operations.remove_if([](const std::shared_ptr<Operation>& operation) {
+        if(operation->checking)
+            return false;
+
+        operation->promise.set_exception(std::make_exception_ptr(std::runtime_error("Operation is cancelled")));
+        return true;
+    });
+}
+
+bool OperationPoller::_check(Operation &operation)
+{
+    try{
+        json result;
+        if(operation.check(result)){
+            operation.promise.set_value(result);
+            return true;
+        }
+    } catch (...){
+        operation.promise.set_exception(std::current_exception());
+        return true;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if(now >= operation.deadline){
+        operation.promise.set_exception(std::make_exception_ptr(std::runtime_error("Operation is too long")));
+        return true;
+    }
+
+    // finished quick operations are noticed at once, long ones are not checked too often
+    operation.interval = std::min(operation.interval * 2, std::chrono::milliseconds(POLL_MAX_INTERVAL));
+    operation.next = now + operation.interval;
+    return false;
+}
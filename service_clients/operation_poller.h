@@ -0,0 +1,77 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifndef CLOUD_STORAGE_OPERATION_POLLER_H
+#define CLOUD_STORAGE_OPERATION_POLLER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../json.hpp"
+
+using namespace nlohmann;
+
+// interval between status checks of one operation grows from min to max, ms
+#define POLL_MIN_INTERVAL 50
+#define POLL_MAX_INTERVAL 2000
+// status requests sent at once
+#define POLL_WORKERS 4
+
+// Status checks of asynchronous service operations (moves, copies, batch jobs).
+// Small fixed pool of workers checks all outstanding operations when they are due,
+// and callers wait on futures instead of sleeping between requests.
+class OperationPoller {
+public:
+    // returns true and sets result when operation is finished, throws if it failed
+    typedef std::function<bool (json& result)> Check;
+
+    ~OperationPoller();
+
+    // check is called until operation is finished or timeout in seconds is reached
+    std::future<json> add(Check check, int timeout);
+
+private:
+    struct Operation {
+        Check check;
+        std::promise<json> promise;
+        std::chrono::steady_clock::time_point next;
+        std::chrono::steady_clock::time_point deadline;
+        std::chrono::milliseconds interval;
+        bool checking = false;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::thread> m_workers;
+    bool m_stop = false;
+    std::list<std::shared_ptr<Operation>> m_operations;
+
+    void _work();
+    // returns true if operation is finished
+    bool _check(Operation &operation);
+};
+
+#endif //CLOUD_STORAGE_OPERATION_POLLER_H
@@ -0,0 +1,90 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#include <functional>
+#include "path_map.h"
+
+PathMap::Shard& PathMap::_get_shard(const std::string &path)
+{
+    return m_shards[std::hash<std::string>()(path) % PATH_MAP_SHARDS];
+}
+
+bool PathMap::get(const std::string &path, std::string &value)
+{
+    Shard& shard = _get_shard(path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.values.find(path);
+    if(it == shard.values.end())
+        return false;
+
+    value = it->second;
+    return true;
+}
+
+std::string PathMap::get(const std::string &path)
+{
+    std::string value;
+    get(path, value);
+    return value;
+}
+
+bool PathMap::contains(const std::string &path)
+{
+    Shard& shard = _get_shard(path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    return shard.values.find(path) != shard.values.end();
+}
+
+void PathMap::put(const std::string &path, const std::string &value)
+{
+    Shard& shard = _get_shard(path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    shard.values[path] = value;
+}
+
+bool PathMap::put_if_absent(const std::string &path, const std::string &value)
+{
+    Shard& shard = _get_shard(path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    return shard.values.insert(std::make_pair(path, value)).second;
+}
+
+void PathMap::erase(const std::string &path)
+{
+    Shard& shard = _get_shard(path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    shard.values.erase(path);
+}
+
+std::map<std::string, std::string> PathMap::snapshot()
+{
+    std::map<std::string, std::string> result;
+    for(Shard& shard: m_shards){
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        result.insert(shard.values.begin(), shard.values.end());
+    }
+
+    return result;
+}
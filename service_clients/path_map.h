@@ -0,0 +1,63 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifndef CLOUD_STORAGE_PATH_MAP_H
+#define CLOUD_STORAGE_PATH_MAP_H
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#define PATH_MAP_SHARDS 16
+
+// Remote path to resource ID (or other value) mappings, shared by concurrent requests of one client.
+// Paths are spread over shards with own locks, so parallel listings and transfers rarely wait for each other.
+class PathMap {
+public:
+    // returns false if path is unknown, value is not changed then
+    bool get(const std::string &path, std::string &value);
+
+    // empty string if path is unknown
+    std::string get(const std::string &path);
+
+    bool contains(const std::string &path);
+
+    void put(const std::string &path, const std::string &value);
+
+    // keeps existing value, returns false if path was known
+    bool put_if_absent(const std::string &path, const std::string &value);
+
+    void erase(const std::string &path);
+
+    // copy of all mappings, for saving and reverse lookups
+    std::map<std::string, std::string> snapshot();
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::map<std::string, std::string> values;
+    };
+
+    Shard m_shards[PATH_MAP_SHARDS];
+
+    Shard& _get_shard(const std::string &path);
+};
+
+#endif //CLOUD_STORAGE_PATH_MAP_H
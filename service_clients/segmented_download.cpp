@@ -0,0 +1,221 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#include <atomic>
+#include <regex>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include "segmented_download.h"
+#include "service_client.h"
+
+SegmentedDownload::SegmentedDownload(const std::string& host, int port, const std::string& path,
+                                     const httplib::Headers& headers, const std::string& method)
+        : m_host(host), m_port(port), m_path(path), m_method(method), m_headers(headers)
+{
+    m_segments = 1;
+    m_segment_size = 0;
+    m_progress = NULL;
+    m_pool = NULL;
+}
+
+std::shared_ptr<httplib::Response> SegmentedDownload::_request(httplib::Client &cli, uint64_t from, uint64_t length,
+                                                               httplib::ContentReceiver receiver,
+                                                               httplib::ResponseHandler handler)
+{
+    httplib::Request req;
+    req.method = m_method;
+    req.path = m_path;
+    req.headers = m_headers;
+    req.content_receiver = receiver;
+    req.response_handler = handler;
+    if(length > 0)
+        req.headers.emplace(httplib::make_range_header(from, from + length - 1));
+    else if(from > 0)
+        req.headers.emplace(httplib::make_range_header(from));
+
+    auto res = std::make_shared<httplib::Response>();
+
+    return cli.send(req, *res) ? res : nullptr;
+}
+
+std::shared_ptr<httplib::Response> SegmentedDownload::run(std::ofstream &ofstream, const std::string &localPath, uint64_t offset)
+{
+    httplib::SSLClient cli(m_host.c_str(), m_port);
+    ServiceClient::setup_http_client(cli, m_pool);
+    bool rangeIgnored = false;
+
+    if(m_progress)
+        m_progress->set_done(offset);
+
+    auto r = _request(cli, offset, m_segment_size, [this, &ofstream](const char* data, size_t data_length){
+        ofstream.write(data, data_length);
+        if(!ofstream.good())
+            return false;
+
+        if(m_progress){
+            m_progress->add(data_length);
+            return m_progress->report();
+        }
+
+        return true;
+    }, [this, &rangeIgnored, offset](const httplib::Response& res){
+        // whole file in response, we cannot append it to the partial local file
+        rangeIgnored = (offset > 0 && res.status == 200);
+        if(m_progress && res.status == 200 && res.has_header("Content-Length"))
+            m_progress->set_total(std::stoull(res.get_header_value("Content-Length")));
+
+        return !rangeIgnored;
+    });
+
+    if(m_progress)
+        m_progress->check_cancelled();
+
+    if(rangeIgnored)
+        throw std::runtime_error("Server does not support download resume");
+
+    // 200 - server ignored Range header and sent the whole file
+    if(!r.get() || r->status != 206)
+        return r;
+
+    uint64_t total;
+    std::smatch m;
+    std::string range_value = r->get_header_value("Content-Range");
+    if (std::regex_search(range_value, m, std::regex("bytes\\s+(\\d+)-(\\d+)/(\\d+)"))) {
+        total = std::stoull(m[3].str());
+    } else {
+        throw std::runtime_error("Error parsing Content-Range header");
+    }
+
+    if(m_progress)
+        m_progress->set_total(total);
+
+    if(m_segment_size > 0 && total > offset + m_segment_size){
+        ofstream.flush();
+        _download_rest(localPath, offset + m_segment_size, total);
+    }
+
+    return r;
+}
+
+bool SegmentedDownload::_is_range(const httplib::Response& res, uint64_t from, uint64_t to)
+{
+    std::smatch m;
+    std::string range_value = res.get_header_value("Content-Range");
+    if(!std::regex_search(range_value, m, std::regex("bytes\\s+(\\d+)-(\\d+)/(\\d+)")))
+        return false;
+
+    return std::stoull(m[1].str()) == from && std::stoull(m[2].str()) == to;
+}
+
+void SegmentedDownload::_download_rest(const std::string &localPath, uint64_t offset, uint64_t total)
+{
+    int fd = open(localPath.c_str(), O_WRONLY);
+    if(fd < 0)
+        throw std::runtime_error("Cannot open file for writing: " + localPath);
+
+    std::atomic<uint64_t> next(offset);
+    std::atomic<bool> failed(false);
+    std::atomic<int> finished(0);
+    std::mutex error_mutex;
+    int error_status = 0;
+
+    auto worker = [&]() {
+        httplib::SSLClient cli(m_host.c_str(), m_port);
+        ServiceClient::setup_http_client(cli, m_pool);
+
+        while(!failed){
+            uint64_t from = next.fetch_add(m_segment_size);
+            if(from >= total)
+                break;
+
+            uint64_t to = std::min(from + m_segment_size, total) - 1;
+            uint64_t pos = from;
+
+            // dropped connection is resumed from the last written byte
+            for(int attempt=1; !failed && pos <= to; attempt++){
+                int status = 0;
+                _request(cli, pos, to - pos + 1, [&](const char* data, size_t data_length){
+                    while(data_length > 0){
+                        ssize_t n = pwrite(fd, data, data_length, pos);
+                        if(n <= 0)
+                            return false;
+
+                        data += n;
+                        data_length -= n;
+                        pos += n;
+                        if(m_progress)
+                            m_progress->add(n);
+                    }
+
+                    return !failed && !(m_progress && m_progress->is_cancelled());
+                }, [&](const httplib::Response& res){
+                    // body of whole file or error page must not be written at the segment offset
+                    status = res.status;
+                    return res.status == 206 && _is_range(res, pos, to);
+                });
+
+                if(pos > to)
+                    break;
+
+                // dropped connection, truncated body or server error
+                bool retry = attempt < SEGMENT_RETRIES && !(m_progress && m_progress->is_cancelled())
+                             && (status == 0 || status == 206 || status >= 500);
+                if(!retry){
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if(!failed && status != 0 && status != 206)
+                        error_status = status;
+                    failed = true;
+                }
+            }
+        }
+
+        finished++;
+    };
+
+    uint64_t count = (total - offset + m_segment_size - 1) / m_segment_size;
+    int workers_count = (int) std::min<uint64_t>(m_segments, count);
+
+    std::vector<std::thread> workers;
+    for(int i=0; i<workers_count; i++)
+        workers.emplace_back(worker);
+
+    // progress is reported from this thread only
+    while(finished < workers_count){
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if(m_progress && !m_progress->report())
+            failed = true;
+    }
+
+    for(auto& t: workers)
+        t.join();
+
+    close(fd);
+
+    if(m_progress)
+        m_progress->check_cancelled();
+
+    if(failed){
+        if(error_status != 0)
+            throw service_client_exception(error_status, "Error downloading file segment");
+        else
+            throw std::runtime_error("Error downloading file segment");
+    }
+}
@@ -0,0 +1,74 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifndef CLOUD_STORAGE_SEGMENTED_DOWNLOAD_H
+#define CLOUD_STORAGE_SEGMENTED_DOWNLOAD_H
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "httplib.h"
+#include "transfer_progress.h"
+
+// attempts to download one segment when connection is dropped or server fails
+#define SEGMENT_RETRIES 3
+
+// Downloads resolved file url by byte ranges, starting from the given offset (resume).
+// First range is written to the output stream, when server reports bigger file size
+// the rest ranges are fetched by several workers over separate connections and
+// written to the local file with pwrite at their offsets.
+class SegmentedDownload {
+public:
+    SegmentedDownload(const std::string& host, int port, const std::string& path,
+                      const httplib::Headers& headers, const std::string& method = "GET");
+
+    void set_segments(int segments) { m_segments = segments; }
+
+    void set_segment_size(uint64_t size) { m_segment_size = size; }
+
+    // received bytes are added to the progress, download stops when it is cancelled
+    void set_progress(TransferProgress* progress) { m_progress = progress; }
+
+    // keep-alive connections of the client which started the download
+    void set_connection_pool(httplib::ConnectionPool* pool) { m_pool = pool; }
+
+    // returns response for the first range request, caller should check its status
+    std::shared_ptr<httplib::Response> run(std::ofstream &ofstream, const std::string &localPath, uint64_t offset = 0);
+
+private:
+    std::string m_host;
+    int m_port;
+    std::string m_path;
+    std::string m_method;
+    httplib::Headers m_headers;
+
+    int m_segments;
+    uint64_t m_segment_size;
+    TransferProgress* m_progress;
+    httplib::ConnectionPool* m_pool;
+
+    // zero length means up to the end of file
+    std::shared_ptr<httplib::Response> _request(httplib::Client &cli, uint64_t from, uint64_t length,
+                                                httplib::ContentReceiver receiver,
+                                                httplib::ResponseHandler handler = nullptr);
+    // Content-Range of response is exactly the requested one
+    bool _is_range(const httplib::Response& res, uint64_t from, uint64_t to);
+    void _download_rest(const std::string &localPath, uint64_t offset, uint64_t total);
+};
+
+#endif //CLOUD_STORAGE_SEGMENTED_DOWNLOAD_H
@@ -80,6 +80,98 @@ int ServiceClient::_get_auth_timeout()
     return m_auth_timeout;
 }
 
+uint64_t ServiceClient::_get_download_segment_size()
+{
+    // zero size means download without Range header
+    if(m_download_segments < 2 || m_download_segment_size <= 0)
+        return 0;
+
+    return (uint64_t) m_download_segment_size * 1024 * 1024;
+}
+
+uint64_t ServiceClient::_get_upload_chunk_size()
+{
+    return (uint64_t) std::max(m_upload_chunk_size, 1) * 1024 * 1024;
+}
+
+httplib::Headers ServiceClient::_get_headers()
+{
+    std::shared_ptr<const httplib::Headers> headers = std::atomic_load(&m_headers);
+    return headers ? *headers : httplib::Headers();
+}
+
+void ServiceClient::_set_headers(const httplib::Headers& headers)
+{
+    std::atomic_store(&m_headers, std::make_shared<const httplib::Headers>(headers));
+}
+
+json ServiceClient::_get_upload_session(const std::string& path)
+{
+    if(!m_upload_sessions)
+        return json();
+
+    return m_upload_sessions->get(m_connection_name, path);
+}
+
+void ServiceClient::_save_upload_session(const std::string& path, const json& session)
+{
+    if(m_upload_sessions)
+        m_upload_sessions->put(m_connection_name, path, session);
+}
+
+void ServiceClient::_remove_upload_session(const std::string& path)
+{
+    if(m_upload_sessions)
+        m_upload_sessions->remove(m_connection_name, path);
+}
+
+httplib::SSLSessionCache& ServiceClient::get_session_cache()
+{
+    static httplib::SSLSessionCache cache;
+    return cache;
+}
+
+bool ServiceClient::is_inside_path(const std::string& folder, const std::string& path)
+{
+    if(folder.empty() || path.size() < folder.size() || path.compare(0, folder.size(), folder) != 0)
+        return false;
+
+    return path.size() == folder.size() || folder.back() == '/' || path[folder.size()] == '/';
+}
+
+void ServiceClient::_skip_deletes(std::vector<BatchOperation>& operations, size_t start, size_t end)
+{
+    for(size_t i=start; i<end; i++){
+        if(operations[i].type != "delete" || !operations[i].error.empty())
+            continue;
+
+        for(size_t j=0; j<i; j++){
+            if(operations[j].type != "delete" && !operations[j].error.empty() && is_inside_path(operations[i].from, operations[j].from)){
+                operations[i].error = BATCH_DELETE_SKIPPED;
+                break;
+            }
+        }
+    }
+}
+
+OperationPoller& ServiceClient::get_operation_poller()
+{
+    static OperationPoller poller;
+    return poller;
+}
+
+void ServiceClient::setup_http_client(httplib::SSLClient& client)
+{
+    setup_http_client(client, &m_connection_pool);
+}
+
+void ServiceClient::setup_http_client(httplib::SSLClient& client, httplib::ConnectionPool* pool)
+{
+    client.set_session_cache(&get_session_cache());
+    if(pool)
+        client.set_connection_pool(pool);
+}
+
 std::string ServiceClient::get_oauth_token()
 {
     httplib::Server server;
@@ -115,9 +207,9 @@ std::string ServiceClient::get_oauth_token()
     return token;
 }
 
-std::__cxx11::string ServiceClient::url_encode(const std::__cxx11::string& s)
+std::string ServiceClient::url_encode(const std::string& s)
 {
-    std::__cxx11::string result;
+    std::string result;
 
     for (auto i = 0; s[i]; i++) {
         switch (s[i]) {
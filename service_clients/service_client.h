@@ -21,15 +21,30 @@ License along with this library; if not, write to the Free Software
 #ifndef CLOUD_STORAGE_SERVICE_CLIENT_H
 #define CLOUD_STORAGE_SERVICE_CLIENT_H
 
+#include <memory>
 #include <string>
 #include <sstream>
 #include "../common.h"
 #include "../json.hpp"
 #include "../library.h"
 #include "../extension.h"
+#include "upload_sessions.h"
+#include "upload_source.h"
+#include "operation_poller.h"
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "httplib.h"
 
 using namespace nlohmann;
 
+#define DEFAULT_DOWNLOAD_SEGMENTS 4
+#define DEFAULT_DOWNLOAD_SEGMENT_SIZE 16
+#define DEFAULT_UPLOAD_CONCURRENCY 4
+#define DEFAULT_UPLOAD_CHUNK_SIZE 16
+
+// attempts to send one chunk of chunked upload
+#define UPLOAD_CHUNK_RETRIES 3
+
 class service_client_exception: public std::runtime_error
 {
 public:
@@ -46,7 +61,7 @@ public:
     }
 
     virtual const char* what() const throw () {
-        msg_.c_str();
+        return msg_.c_str();
     }
 
     int get_status(){ return status_code; }
@@ -59,20 +74,60 @@ protected:
 };
 
 
+// remote operation collected into a batch, type is "delete", "move" or "copy"
+struct BatchOperation {
+    std::string type;
+    std::string from;
+    std::string to;
+    std::string error;  // message of failed or skipped operation
+};
+
+// files which were not moved would be removed together with the source folder
+#define BATCH_DELETE_SKIPPED "Not deleted, moving or copying of its content failed"
+
+
 class ServiceClient {
 protected:
     int m_port;
     int m_auth_timeout;
     std::string m_client_id;
+    int m_download_segments;
+    int m_download_segment_size;
+    int m_upload_concurrency;
+    int m_upload_chunk_size;
+    UploadSessions* m_upload_sessions;
+    std::string m_connection_name;
 
-    std::__cxx11::string url_encode(const std::__cxx11::string& s);
+    // keep-alive connections of this client, not shared with other accounts
+    httplib::ConnectionPool m_connection_pool;
+
+    std::string url_encode(const std::string& s);
     int _get_port();
     int _get_auth_timeout();
+    uint64_t _get_download_segment_size();
+    uint64_t _get_upload_chunk_size();
+
+    // records of interrupted uploads, to continue them with FS_COPYFLAGS_RESUME
+    json _get_upload_session(const std::string& path);
+    void _save_upload_session(const std::string& path, const json& session);
+    void _remove_upload_session(const std::string& path);
     virtual std::string _get_client_id() { return m_client_id; };
 
+    // request context with the current token, it is replaced as a whole,
+    // so concurrent requests keep their own copy of headers
+    httplib::Headers _get_headers();
+    void _set_headers(const httplib::Headers& headers);
+
+    // deletes in [start, end) are skipped when they contain source of previous failed move or copy
+    static void _skip_deletes(std::vector<BatchOperation>& operations, size_t start, size_t end);
+
+private:
+    std::shared_ptr<const httplib::Headers> m_headers;
+
 public:
 
-    ServiceClient(){ m_port = 3359; m_auth_timeout = 20; };
+    ServiceClient(){ m_port = 3359; m_auth_timeout = 20; m_download_segments = DEFAULT_DOWNLOAD_SEGMENTS; m_download_segment_size = DEFAULT_DOWNLOAD_SEGMENT_SIZE;
+        m_upload_concurrency = DEFAULT_UPLOAD_CONCURRENCY; m_upload_chunk_size = DEFAULT_UPLOAD_CHUNK_SIZE; m_upload_sessions = NULL; };
 
     virtual ~ServiceClient() {};
 
@@ -90,9 +145,12 @@ public:
 
     virtual void removeResource(std::string utf8Path) = 0;
 
-    virtual void downloadFile(std::string path, std::ofstream &ofstream, std::string localPath) = 0;
+    // offset > 0 continues download to the end of partially downloaded file,
+    // progress can be NULL
+    virtual void downloadFile(std::string path, std::ofstream &ofstream, std::string localPath, uint64_t offset, TransferProgress* progress) = 0;
 
-    virtual void uploadFile(std::string path, std::ifstream &ifstream, BOOL overwrite) = 0;
+    // resume continues upload from the saved upload session, if service supports it
+    virtual void uploadFile(std::string path, UploadSource &source, BOOL overwrite, BOOL resume) = 0;
 
     virtual void move(std::string from, std::string to, BOOL overwrite) = 0;
 
@@ -114,6 +172,59 @@ public:
 
     virtual void set_client_id(std::string client_id) { m_client_id = client_id; };
 
+    // number of parallel connections for one file download
+    virtual void set_download_segments(int segments) { m_download_segments = segments; };
+
+    // size of one downloaded range, Mb
+    virtual void set_download_segment_size(int size) { m_download_segment_size = size; };
+
+    // number of chunks uploaded in parallel, if service supports it
+    virtual void set_upload_concurrency(int concurrency) { m_upload_concurrency = concurrency; };
+
+    // size of one uploaded chunk, Mb
+    virtual void set_upload_chunk_size(int size) { m_upload_chunk_size = size; };
+
+    virtual void set_upload_sessions(UploadSessions* sessions, std::string connection) {
+        m_upload_sessions = sessions;
+        m_connection_name = connection;
+    };
+
+    // known path to resource ID mappings, to restore them after restart
+    virtual json get_metadata() { return json::object(); };
+
+    // merge saved mappings into the client
+    virtual void set_metadata(const json& metadata) {};
+
+    // changes since cursor: {"cursor": next cursor, "paths": changed paths, "reset": cursor has expired},
+    // empty cursor returns the current one, null if service has no change feed
+    virtual json get_changes(const std::string& cursor) { return json(); };
+
+    // max operations sent in one batch request, 0 if service has no batch api
+    virtual size_t get_batch_limit() { return 0; };
+
+    // operations are run in the given order, move and copy do not overwrite,
+    // error is set for every failed operation, operations with error are not run
+    virtual void run_batch(std::vector<BatchOperation>& operations) { throw std::runtime_error("Not supported"); };
+
+    // path is the folder itself or is inside it
+    static bool is_inside_path(const std::string& folder, const std::string& path);
+
+    // paths are equal or one is inside another
+    static bool is_related_path(const std::string& a, const std::string& b) { return is_inside_path(a, b) || is_inside_path(b, a); }
+
+    httplib::ConnectionPool& get_connection_pool() { return m_connection_pool; }
+
+    // TLS sessions shared by all service clients
+    static httplib::SSLSessionCache& get_session_cache();
+
+    // status checks of asynchronous operations of all service clients
+    static OperationPoller& get_operation_poller();
+
+    // attach connection pool of this client and shared TLS session cache to http client
+    void setup_http_client(httplib::SSLClient& client);
+
+    // pool can be NULL, then connections are not reused
+    static void setup_http_client(httplib::SSLClient& client, httplib::ConnectionPool* pool);
 };
 
 #endif //CLOUD_STORAGE_SERVICE_CLIENT_H
@@ -21,6 +21,9 @@ License along with this library; if not, write to the Free Software
 #ifndef CLOUD_STORAGE_SERVICE_FACTORY_H
 #define CLOUD_STORAGE_SERVICE_FACTORY_H
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include "dummy_client.h"
 #include "yandex_rest_client.h"
 #include "dropbox_client.h"
@@ -30,12 +33,6 @@ License along with this library; if not, write to the Free Software
 
 class ServiceFactory final {
 private:
-    DummyClient* dummyClient;
-    YandexRestClient* yandexClient;
-    DropboxClient* dropboxClient;
-    GoogleDriveClient* googledriveClient;
-    OneDriveClient* onedriveClient;
-
     std::vector<std::pair<std::string, std::string> > names = {
             {"yandex", "Yandex Disk"},
             {"dropbox", "Dropbox"},
@@ -44,69 +41,62 @@ private:
             //{"dummy", "Dummy"}
     };
 
-public:
-    ServiceFactory() {
-        dummyClient = NULL;
-        yandexClient = NULL;
-        dropboxClient = NULL;
-        googledriveClient = NULL;
-        onedriveClient = NULL;
-    }
+    // one client per connection, so accounts of the same service do not share tokens and mappings
+    std::mutex m_mutex;
+    std::map<std::string, std::unique_ptr<ServiceClient>> m_clients;
 
-    ~ServiceFactory(){
-        if(dummyClient)
-            delete dummyClient;
+public:
+    std::vector<std::pair<std::string, std::string> > get_names() { return names; }
 
-        if(yandexClient)
-            delete yandexClient;
+    // client of the connection, created on first use, second value is true for the new client
+    std::pair<ServiceClient*, bool> getClient(std::string& client, const std::string& connection){
+        std::lock_guard<std::mutex> lock(m_mutex);
 
-        if(dropboxClient)
-            delete dropboxClient;
+        std::unique_ptr<ServiceClient>& instance = m_clients[connection];
+        if(instance)
+            return std::make_pair(instance.get(), false);
 
-        if(googledriveClient)
-            delete googledriveClient;
+        instance.reset(createClient(client));
+        if(!instance){
+            m_clients.erase(connection);
+            return std::make_pair((ServiceClient*) NULL, false);
+        }
 
-        if(onedriveClient)
-            delete onedriveClient;
+        return std::make_pair(instance.get(), true);
     }
 
-    std::vector<std::pair<std::string, std::string> > get_names() { return names; }
-
-    ServiceClient* getClient(std::string& client){
-        if(client == "dummy"){
-            if(!dummyClient)
-                dummyClient = new DummyClient();
-
-            return dummyClient;
-        }
+    // connection is removed or its settings are changed
+    void removeClient(const std::string& connection){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_clients.erase(connection);
+    }
 
-        if(client == "yandex"){
-            if(!yandexClient)
-                yandexClient = new YandexRestClient();
+    std::vector<ServiceClient*> getClients(){
+        std::lock_guard<std::mutex> lock(m_mutex);
 
-            return yandexClient;
-        }
+        std::vector<ServiceClient*> clients;
+        for(auto& it: m_clients)
+            clients.push_back(it.second.get());
 
-        if(client == "dropbox"){
-            if(!dropboxClient)
-                dropboxClient = new DropboxClient();
+        return clients;
+    }
 
-            return dropboxClient;
-        }
+    // new client instance owned by the caller, i.e. for background work
+    ServiceClient* createClient(std::string& client){
+        if(client == "dummy")
+            return new DummyClient();
 
-        if(client == "gdrive"){
-            if(!googledriveClient)
-                googledriveClient = new GoogleDriveClient();
+        if(client == "yandex")
+            return new YandexRestClient();
 
-            return googledriveClient;
-        }
+        if(client == "dropbox")
+            return new DropboxClient();
 
-        if(client == "onedrive"){
-            if(!onedriveClient)
-                onedriveClient = new OneDriveClient();
+        if(client == "gdrive")
+            return new GoogleDriveClient();
 
-            return onedriveClient;
-        }
+        if(client == "onedrive")
+            return new OneDriveClient();
 
         return NULL;
     }
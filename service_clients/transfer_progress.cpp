@@ -0,0 +1,53 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#include <algorithm>
+#include "transfer_progress.h"
+
+TransferProgress::TransferProgress(Callback callback, uint64_t total)
+        : m_callback(callback), m_owner(std::this_thread::get_id()), m_total(total), m_done(0), m_cancelled(false)
+{
+}
+
+bool TransferProgress::report(bool force)
+{
+    if(m_cancelled || !m_callback || std::this_thread::get_id() != m_owner)
+        return !m_cancelled;
+
+    auto now = std::chrono::steady_clock::now();
+    if(!force && now - m_last_report < std::chrono::milliseconds(PROGRESS_INTERVAL))
+        return true;
+
+    m_last_report = now;
+
+    // repeated chunks can be counted twice
+    uint64_t total = m_total;
+    uint64_t done = std::min<uint64_t>(m_done, total);
+    if(!m_callback(done, total))
+        m_cancelled = true;
+
+    return !m_cancelled;
+}
+
+void TransferProgress::check_cancelled() const
+{
+    if(m_cancelled)
+        throw transfer_cancelled_exception();
+}
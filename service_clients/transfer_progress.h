@@ -0,0 +1,76 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifndef CLOUD_STORAGE_TRANSFER_PROGRESS_H
+#define CLOUD_STORAGE_TRANSFER_PROGRESS_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+// minimal time between two progress callbacks, ms
+#define PROGRESS_INTERVAL 250
+
+class transfer_cancelled_exception: public std::runtime_error
+{
+public:
+    transfer_cancelled_exception(): std::runtime_error("Transfer is cancelled") {}
+};
+
+// Bytes transferred by one file download or upload.
+// Bytes can be added from any worker thread, callback is called only from the thread
+// which created the object, because plugin progress callback is not thread-safe.
+class TransferProgress {
+public:
+    // callback returns false to cancel transfer
+    typedef std::function<bool (uint64_t done, uint64_t total)> Callback;
+
+    explicit TransferProgress(Callback callback, uint64_t total = 0);
+
+    void set_total(uint64_t total) { m_total = total; }
+
+    // bytes done before the transfer, i.e. resumed part of file
+    void set_done(uint64_t done) { m_done = done; }
+
+    void add(uint64_t bytes) { m_done += bytes; }
+
+    // calls callback if interval has passed, returns false if transfer is cancelled
+    bool report(bool force = false);
+
+    bool is_cancelled() const { return m_cancelled; }
+
+    // can be called from any thread
+    void cancel() { m_cancelled = true; }
+
+    // throws transfer_cancelled_exception if transfer is cancelled
+    void check_cancelled() const;
+
+private:
+    Callback m_callback;
+    std::thread::id m_owner;
+    std::atomic<uint64_t> m_total;
+    std::atomic<uint64_t> m_done;
+    std::atomic<bool> m_cancelled;
+    std::chrono::steady_clock::time_point m_last_report;
+};
+
+#endif //CLOUD_STORAGE_TRANSFER_PROGRESS_H
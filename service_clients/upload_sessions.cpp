@@ -0,0 +1,83 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#include <fstream>
+#include <iomanip>
+#include "upload_sessions.h"
+
+void UploadSessions::load(const std::string &filePath)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_file_path = filePath;
+
+    std::ifstream i(m_file_path);
+    if(i){
+        try{
+            i >> m_sessions;
+        } catch(...){
+            m_sessions = json::object();
+        }
+    }
+
+    if(!m_sessions.is_object())
+        m_sessions = json::object();
+}
+
+json UploadSessions::get(const std::string &connection, const std::string &remotePath)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_sessions.find(connection);
+    if(it == m_sessions.end() || it->find(remotePath) == it->end())
+        return json();
+
+    return (*it)[remotePath];
+}
+
+void UploadSessions::put(const std::string &connection, const std::string &remotePath, const json &session)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sessions[connection][remotePath] = session;
+    _save();
+}
+
+void UploadSessions::remove(const std::string &connection, const std::string &remotePath)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_sessions.find(connection);
+    if(it == m_sessions.end() || it->find(remotePath) == it->end())
+        return;
+
+    it->erase(remotePath);
+    if(it->empty())
+        m_sessions.erase(it);
+
+    _save();
+}
+
+void UploadSessions::_save()
+{
+    if(m_file_path.empty())
+        return;
+
+    std::ofstream o(m_file_path);
+    o << std::setw(4) << m_sessions << std::endl;
+}
@@ -0,0 +1,50 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifndef CLOUD_STORAGE_UPLOAD_SESSIONS_H
+#define CLOUD_STORAGE_UPLOAD_SESSIONS_H
+
+#include <mutex>
+#include <string>
+#include "../json.hpp"
+
+using namespace nlohmann;
+
+// Persisted records of unfinished resumable uploads.
+// Every record is stored by connection name and remote path, content depends on the service.
+class UploadSessions {
+public:
+    void load(const std::string &filePath);
+
+    json get(const std::string &connection, const std::string &remotePath);
+
+    void put(const std::string &connection, const std::string &remotePath, const json &session);
+
+    void remove(const std::string &connection, const std::string &remotePath);
+
+private:
+    std::mutex m_mutex;
+    std::string m_file_path;
+    json m_sessions;
+
+    void _save();
+};
+
+#endif //CLOUD_STORAGE_UPLOAD_SESSIONS_H
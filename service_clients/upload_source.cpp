@@ -0,0 +1,118 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "upload_source.h"
+
+UploadSource::UploadSource()
+{
+    m_fd = -1;
+    m_data = NULL;
+    m_size = 0;
+    m_progress = NULL;
+}
+
+UploadSource::~UploadSource()
+{
+    close();
+}
+
+bool UploadSource::open(const std::string &path)
+{
+    close();
+
+    m_fd = ::open(path.c_str(), O_RDONLY);
+    if(m_fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(m_fd, &st) != 0 || !S_ISREG(st.st_mode)){
+        close();
+        return false;
+    }
+
+    m_size = st.st_size;
+    if(m_size == 0) // empty file cannot be mapped
+        return true;
+
+    void* data = mmap(NULL, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if(data == MAP_FAILED){
+        close();
+        return false;
+    }
+
+    m_data = (const char*) data;
+    madvise(data, m_size, MADV_SEQUENTIAL);
+
+    return true;
+}
+
+void UploadSource::close()
+{
+    if(m_data)
+        munmap((void*) m_data, m_size);
+
+    if(m_fd >= 0)
+        ::close(m_fd);
+
+    m_fd = -1;
+    m_data = NULL;
+    m_size = 0;
+}
+
+void UploadSource::prefetch(int64_t from, int64_t length) const
+{
+    // madvise needs page aligned address
+    static const int64_t page = sysconf(_SC_PAGESIZE);
+    int64_t start = from - from % page;
+    int64_t end = std::min(from + length, m_size);
+    if(m_data && start < end)
+        madvise((void*) (m_data + start), end - start, MADV_WILLNEED);
+}
+
+httplib::ContentProvider UploadSource::provider(int64_t start) const
+{
+    return [this, start](uint64_t offset, uint64_t length, httplib::DataSink sink) {
+        int64_t pos = start + offset;
+        int64_t size = std::min<int64_t>(std::min<uint64_t>(length, UPLOAD_SLICE_SIZE), m_size - pos);
+        if(size <= 0)
+            return false;
+
+        // next window is read from disk while the current one is sent
+        if(offset == 0)
+            prefetch(pos, UPLOAD_READAHEAD_SIZE);
+        if(pos % UPLOAD_READAHEAD_SIZE < UPLOAD_SLICE_SIZE)
+            prefetch(pos - pos % UPLOAD_READAHEAD_SIZE + UPLOAD_READAHEAD_SIZE, UPLOAD_READAHEAD_SIZE);
+
+        if(!sink(m_data + pos, size))
+            return false;
+
+        if(m_progress){
+            m_progress->add(size);
+            return m_progress->report();
+        }
+
+        return true;
+    };
+}
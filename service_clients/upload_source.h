@@ -0,0 +1,74 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifndef CLOUD_STORAGE_UPLOAD_SOURCE_H
+#define CLOUD_STORAGE_UPLOAD_SOURCE_H
+
+#include <string>
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "httplib.h"
+#include "transfer_progress.h"
+
+// piece of mapping passed to the connection in one write
+#define UPLOAD_SLICE_SIZE (1024 * 1024)
+
+// pages requested from disk ahead of the current upload position
+#define UPLOAD_READAHEAD_SIZE (16 * 1024 * 1024)
+
+// Local file mapped into memory for upload.
+// Request bodies are written directly from the mapping, without copying into buffers.
+class UploadSource {
+public:
+    UploadSource();
+    ~UploadSource();
+
+    UploadSource(const UploadSource&) = delete;
+    UploadSource& operator=(const UploadSource&) = delete;
+
+    // returns false if file cannot be opened or mapped
+    bool open(const std::string& path);
+
+    void close();
+
+    int64_t size() const { return m_size; }
+
+    // request body from the start position up to the length given to the request,
+    // source must be alive until request is finished
+    httplib::ContentProvider provider(int64_t start) const;
+
+    // ask the kernel to read pages in background, before they are sent
+    void prefetch(int64_t from, int64_t length) const;
+
+    // sent bytes are added to the progress, providers stop sending when it is cancelled
+    void set_progress(TransferProgress* progress) { m_progress = progress; }
+
+    TransferProgress* get_progress() const { return m_progress; }
+
+    bool is_cancelled() const { return m_progress && m_progress->is_cancelled(); }
+
+private:
+    int m_fd;
+    const char* m_data;
+    int64_t m_size;
+    TransferProgress* m_progress;
+};
+
+#endif //CLOUD_STORAGE_UPLOAD_SOURCE_H
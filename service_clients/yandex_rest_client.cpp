@@ -18,13 +18,16 @@ License along with this library; if not, write to the Free Software
         Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
 */
 
+#include <atomic>
 #include <string>
+#include <thread>
 #include <future>
 #include "../common.h"
 #include "../library.h"
 #include "../wfxplugin.h"
 #include "../plugin_utils.h"
 #include "yandex_rest_client.h"
+#include "segmented_download.h"
 #include "httplib.h"
 
 #define FILE_LIMIT 1000
@@ -32,6 +35,7 @@ License along with this library; if not, write to the Free Software
 YandexRestClient::YandexRestClient(){
     m_client_id = "bc2f272cc37349b7a1320b9ac7826ebf";
     m_http_client = new httplib::SSLClient("cloud-api.yandex.net");
+    setup_http_client(*m_http_client);
 }
 
 YandexRestClient::~YandexRestClient(){
@@ -67,7 +71,7 @@ void YandexRestClient::set_oauth_token(const char *token)
 
     std::string header_token = "OAuth ";
     header_token += token;
-    m_headers = { {"Authorization", header_token} };
+    _set_headers({ {"Authorization", header_token} });
 }
 
 pResources YandexRestClient::get_resources(std::string path, BOOL isTrash)
@@ -83,7 +87,7 @@ pResources YandexRestClient::get_resources(std::string path, BOOL isTrash)
             url += "trash/";
         url += "resources?limit=" + std::to_string(FILE_LIMIT) + "&offset=" + std::to_string(offset) + "&path=";
         url += url_encode(path);
-        auto r = m_http_client->Get(url.c_str(), m_headers);
+        auto r = m_http_client->Get(url.c_str(), _get_headers());
 
         if(r.get() && r->status==200){
             const auto json = json::parse(r->body);
@@ -125,8 +129,7 @@ void YandexRestClient::prepare_folder_result(json json, BOOL isRoot, pResources
 
         if(item["type"].get<std::string>() == "file") {
             file.dwFileAttributes = 0;
-            file.nFileSizeLow = (DWORD) item["size"].get<int>();
-            file.nFileSizeHigh = 0;
+            set_file_size(file, item["size"].get<uint64_t>());
         } else {
             file.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
             file.nFileSizeLow = 0;
@@ -144,7 +147,7 @@ void YandexRestClient::makeFolder(std::string utf8Path)
     std::string url("/v1/disk/resources?path=");
     url += url_encode(utf8Path);
     std::string empty_body;
-    auto r = m_http_client->Put(url.c_str(), m_headers, empty_body, "text/plain");
+    auto r = m_http_client->Put(url.c_str(), _get_headers(), empty_body, "text/plain");
 
     if(!r.get() || r->status!=201)
         throw_response_error(r.get());
@@ -155,7 +158,7 @@ void YandexRestClient::removeResource(std::string utf8Path)
 {
     std::string url("/v1/disk/resources?path=");
     url += url_encode(utf8Path);
-    auto r = m_http_client->Delete(url.c_str(), m_headers);
+    auto r = m_http_client->Delete(url.c_str(), _get_headers());
 
     if(r.get() && r->status==204){
         //empty folder or file was removed
@@ -170,6 +173,11 @@ void YandexRestClient::removeResource(std::string utf8Path)
 }
 
 void YandexRestClient::wait_success_operation(std::string &body)
+{
+    _track_operation(body).get();
+}
+
+std::future<json> YandexRestClient::_track_operation(const std::string &body)
 {
     const auto json = json::parse(body);
     if(!json["href"].is_string())
@@ -177,43 +185,131 @@ void YandexRestClient::wait_success_operation(std::string &body)
 
     int pos = json["href"].get<std::string>().find("/v1/disk");
     std::string url_status = json["href"].get<std::string>().substr(pos);
-    BOOL success = false;
-    int waitCount = 0;
-    do{
-        std::this_thread::sleep_for(std::chrono::seconds(2));
-        auto r2 = m_http_client->Get(url_status.c_str(), m_headers);
-        if(r2.get() && r2->status==200){
-            const auto json2 = json::parse(r2->body);
 
-            if(!json2["status"].is_string())
-                throw std::runtime_error("Getting operation status error: unknown json format");
+    return get_operation_poller().add([this, url_status](nlohmann::json& result){
+        auto r2 = m_http_client->Get(url_status.c_str(), _get_headers());
+        if(!r2.get() || r2->status!=200)
+            throw std::runtime_error("Error getting operation status");
 
-            if(json2["status"].get<std::string>() == "success")
-                success = true;
+        result = json::parse(r2->body);
+        if(!result["status"].is_string())
+            throw std::runtime_error("Getting operation status error: unknown json format");
 
-            if(json2["status"].get<std::string>() == "failure")
-                throw service_client_exception(500, "Operation error");
+        if(result["status"].get<std::string>() == "failure")
+            throw service_client_exception(500, "Operation error");
 
-            // if(json2["status"].string_value() == "in-progress") - Do nothing, just wait
-            waitCount++;
-        } else {
-            throw std::runtime_error("Error getting operation status");
+        // "in-progress" - check again later
+        return result["status"].get<std::string>() == "success";
+    }, YANDEX_OPERATION_TIMEOUT);
+}
+
+void YandexRestClient::run_batch(std::vector<BatchOperation>& operations)
+{
+    // operations of one group do not touch paths of each other and run together,
+    // operation on the path of previous one waits for its group
+    size_t start = 0;
+    while(start < operations.size()){
+        size_t end = start + 1;
+        while(end < operations.size()){
+            bool related = false;
+            for(size_t i=start; i<end && !related; i++){
+                related = is_related_path(operations[i].from, operations[end].from) || is_related_path(operations[i].from, operations[end].to)
+                          || is_related_path(operations[i].to, operations[end].from) || is_related_path(operations[i].to, operations[end].to);
+            }
+            if(related)
+                break;
+            end++;
+        }
+
+        // results of previous groups are known here
+        _skip_deletes(operations, start, end);
+        _run_batch(operations, start, end);
+        start = end;
+    }
+}
+
+void YandexRestClient::_run_batch(std::vector<BatchOperation>& operations, size_t start, size_t end)
+{
+    std::vector<std::future<json>> pending(end - start);
+    std::vector<std::string> messages(end - start);
+    std::atomic<size_t> next(start);
+
+    // requests are sent by several workers, server continues not empty folders asynchronously
+    auto worker = [&]() {
+        for(size_t i = next++; i < end; i = next++){
+            if(!operations[i].error.empty())
+                continue;
+
+            try{
+                pending[i - start] = _start_operation(operations[i]);
+            } catch (std::exception & e){
+                messages[i - start] = e.what();
+            }
         }
+    };
+
+    std::vector<std::thread> workers;
+    for(size_t i=1; i<std::min<size_t>(YANDEX_BATCH_CONCURRENCY, end - start); i++)
+        workers.emplace_back(worker);
+    worker();
+    for(auto& t: workers)
+        t.join();
+
+    // statuses of all accepted operations are checked together
+    for(size_t i=start; i<end; i++){
+        if(!pending[i - start].valid())
+            continue;
+
+        try{
+            pending[i - start].get();
+        } catch (std::exception & e){
+            messages[i - start] = e.what();
+        }
+    }
 
-    } while(success==false && waitCount<30); //wait at least 1 min
+    for(size_t i=start; i<end; i++){
+        if(!messages[i - start].empty())
+            operations[i].error = messages[i - start];
+    }
+}
 
-    if(success==false && waitCount>=30)
-        throw std::runtime_error("Operation is too long");
+std::future<json> YandexRestClient::_start_operation(const BatchOperation& operation)
+{
+    std::string empty_body;
+    std::shared_ptr<httplib::Response> r;
+    if(operation.type == "delete"){
+        std::string url("/v1/disk/resources?path=");
+        url += url_encode(operation.from);
+        r = m_http_client->Delete(url.c_str(), _get_headers());
+
+        // already deleted, i.e. together with its folder
+        if(r.get() && r->status==404)
+            return std::future<json>();
+    } else if(operation.type == "move" || operation.type == "copy"){
+        std::string url("/v1/disk/resources/" + operation.type + "?from=");
+        url += url_encode(operation.from) + "&path=" + url_encode(operation.to) + "&overwrite=false";
+        r = m_http_client->Post(url.c_str(), _get_headers(), empty_body, "text/plain");
+    } else {
+        throw std::runtime_error("Not supported");
+    }
+
+    if(r.get() && (r->status==201 || r->status==204))
+        return std::future<json>();
+
+    if(r.get() && r->status==202)
+        return _track_operation(r->body);
 
+    throw_response_error(r.get());
+    return std::future<json>();
 }
 
-void YandexRestClient::downloadFile(std::string path, std::ofstream &ofstream, std::string localPath)
+void YandexRestClient::downloadFile(std::string path, std::ofstream &ofstream, std::string localPath, uint64_t offset, TransferProgress* progress)
 {
     std::string url("/v1/disk/resources/download?path=");
     url += url_encode(path);
 
     // Get download link
-    auto r = m_http_client->Get(url.c_str(), m_headers);
+    auto r = m_http_client->Get(url.c_str(), _get_headers());
     if(r.get() && r->status==200){
         const auto js = json::parse(r->body);
 
@@ -225,11 +321,11 @@ void YandexRestClient::downloadFile(std::string path, std::ofstream &ofstream, s
         throw_response_error(r.get());
     }
 
-    _do_download(url, ofstream);
+    _do_download(url, ofstream, localPath, offset, progress);
 
 }
 
-void YandexRestClient::_do_download(std::string url, std::ofstream &ofstream){
+void YandexRestClient::_do_download(std::string url, std::ofstream &ofstream, std::string &localPath, uint64_t offset, TransferProgress* progress){
     std::string server_url, request_url;
 
     std::smatch m;
@@ -241,13 +337,18 @@ void YandexRestClient::_do_download(std::string url, std::ofstream &ofstream){
         throw std::runtime_error("Error parsing file href for download");
     }
 
-    httplib::SSLClient cli2(server_url.c_str());
-    auto r2 = cli2.Get(request_url.c_str());
-    if(r2.get() && r2->status == 200){
-        ofstream.write(r2->body.data(), r2->body.size());
+    SegmentedDownload download(server_url, 443, request_url, httplib::Headers());
+    download.set_segments(m_download_segments);
+    download.set_segment_size(_get_download_segment_size());
+    download.set_progress(progress);
+    download.set_connection_pool(&m_connection_pool);
+
+    auto r2 = download.run(ofstream, localPath, offset);
+    if(r2.get() && (r2->status == 200 || r2->status == 206)){
+        return;
     } else if(r2.get() && r2->status == 302){ //redirect
         if(r2->has_header("Location"))
-            _do_download(r2->get_header_value("Location"), ofstream);
+            _do_download(r2->get_header_value("Location"), ofstream, localPath, offset, progress);
         else
             throw std::runtime_error("Cannot find redirect link");
     } else {
@@ -255,14 +356,15 @@ void YandexRestClient::_do_download(std::string url, std::ofstream &ofstream){
     }
 }
 
-void YandexRestClient::uploadFile(std::string path, std::ifstream& ifstream, BOOL overwrite)
+// Yandex upload urls are single request only, resume is ignored
+void YandexRestClient::uploadFile(std::string path, UploadSource &source, BOOL overwrite, BOOL resume)
 {
     std::string url("/v1/disk/resources/upload?path=");
     url += url_encode(path);
     url += "&overwrite=";
     url += (overwrite ? "true": "false");
 
-    auto r = m_http_client->Get(url.c_str(), m_headers);
+    auto r = m_http_client->Get(url.c_str(), _get_headers());
     if(r.get() && r->status==200){
         const auto js = json::parse(r->body);
         url = js["href"].get<std::string>();
@@ -270,9 +372,6 @@ void YandexRestClient::uploadFile(std::string path, std::ifstream& ifstream, BOO
         throw_response_error(r.get());
     }
 
-    std::stringstream body;
-    body << ifstream.rdbuf();
-
     std::string server_url, request_url;
     std::smatch m;
     auto pattern = std::regex("https://(.+?):443(/.+)");
@@ -284,7 +383,10 @@ void YandexRestClient::uploadFile(std::string path, std::ifstream& ifstream, BOO
     }
 
     httplib::SSLClient cli2(server_url.c_str(), 443);
-    auto r2 = cli2.Put(request_url.c_str(), m_headers, body.str(), "application/octet-stream");
+    setup_http_client(cli2);
+    auto r2 = cli2.Put(request_url.c_str(), _get_headers(), source.size(), source.provider(0), "application/octet-stream");
+    if(source.is_cancelled())
+        throw transfer_cancelled_exception();
 
     if(r2.get() && (r2->status==201 || r2->status==202)){
         return;
@@ -300,7 +402,7 @@ void YandexRestClient::move(std::string from, std::string to, BOOL overwrite)
     url += "&overwrite=";
     url += (overwrite == true ? "true": "false");
     std::string empty_body;
-    auto r = m_http_client->Post(url.c_str(), m_headers, empty_body, "text/plain");
+    auto r = m_http_client->Post(url.c_str(), _get_headers(), empty_body, "text/plain");
 
     if(r.get() && r->status==201){
         //success
@@ -321,7 +423,7 @@ void YandexRestClient::copy(std::string from, std::string to, BOOL overwrite)
     url += "&overwrite=";
     url += (overwrite == true ? "true": "false");
     std::string empty_body;
-    auto r = m_http_client->Post(url.c_str(), m_headers, empty_body, "text/plain");
+    auto r = m_http_client->Post(url.c_str(), _get_headers(), empty_body, "text/plain");
 
     if(r.get() && r->status==201){
         //success
@@ -338,7 +440,7 @@ void YandexRestClient::copy(std::string from, std::string to, BOOL overwrite)
 void YandexRestClient::cleanTrash()
 {
     std::string url("/v1/disk/trash/resources");
-    auto r = m_http_client->Delete(url.c_str(), m_headers);
+    auto r = m_http_client->Delete(url.c_str(), _get_headers());
 
     if(r.get() && r->status==204){
         return;
@@ -355,7 +457,7 @@ void YandexRestClient::deleteFromTrash(std::string utf8Path)
 {
     std::string url("/v1/disk/trash/resources?path=");
     url += url_encode(utf8Path);
-    auto r = m_http_client->Delete(url.c_str(), m_headers);
+    auto r = m_http_client->Delete(url.c_str(), _get_headers());
 
     if(r.get() && r->status==204){
         return;
@@ -373,7 +475,7 @@ void YandexRestClient::saveFromUrl(std::string urlFrom, std::string pathTo)
     std::string url("/v1/disk/resources/upload?url=");
     url += url_encode(urlFrom) + "&path=" + url_encode(pathTo);
     std::string empty_body;
-    auto r = m_http_client->Post(url.c_str(), m_headers, empty_body, "text/plain");
+    auto r = m_http_client->Post(url.c_str(), _get_headers(), empty_body, "text/plain");
 
     if(r.get() && r->status==202){
         wait_success_operation(r->body);
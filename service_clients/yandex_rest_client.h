@@ -26,6 +26,12 @@ License along with this library; if not, write to the Free Software
 #include "httplib.h"
 #include "../library.h"
 
+// seconds to wait for asynchronous move, copy or remove
+#define YANDEX_OPERATION_TIMEOUT 60
+// collected moves, copies and deletes, and how many of them are sent at once
+#define YANDEX_BATCH_LIMIT 1000
+#define YANDEX_BATCH_CONCURRENCY 8
+
 class YandexRestClient: public ServiceClient {
 public:
     YandexRestClient();
@@ -45,9 +51,9 @@ public:
 
     void removeResource(std::string utf8Path);
 
-    void downloadFile(std::string path, std::ofstream &ofstream, std::string localPath);
+    void downloadFile(std::string path, std::ofstream &ofstream, std::string localPath, uint64_t offset, TransferProgress* progress);
 
-    void uploadFile(std::string path, std::ifstream &ifstream, BOOL overwrite);
+    void uploadFile(std::string path, UploadSource &source, BOOL overwrite, BOOL resume);
 
     void move(std::string from, std::string to, BOOL overwrite);
 
@@ -63,13 +69,21 @@ public:
 
     void run_command(std::string remoteName, std::vector<std::string> &arguments);
 
+    size_t get_batch_limit() { return YANDEX_BATCH_LIMIT; }
+
+    void run_batch(std::vector<BatchOperation>& operations);
+
 private:
     httplib::SSLClient* m_http_client;
-    httplib::Headers m_headers;
 
     void throw_response_error(httplib::Response* resp);
     void wait_success_operation(std::string &body);
-    void _do_download(std::string url, std::ofstream &ofstream);
+    // status of asynchronous operation from 202 response body
+    std::future<json> _track_operation(const std::string &body);
+    // future is not valid when operation is already finished
+    std::future<json> _start_operation(const BatchOperation& operation);
+    void _run_batch(std::vector<BatchOperation>& operations, size_t start, size_t end);
+    void _do_download(std::string url, std::ofstream &ofstream, std::string &localPath, uint64_t offset, TransferProgress* progress);
     void prepare_folder_result(json json, BOOL isRoot, pResources pRes, int& total);
 
 };
@@ -0,0 +1,191 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#include "transfer_scheduler.h"
+
+TransferScheduler::~TransferScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+
+    for(auto& t: m_workers)
+        t.join();
+}
+
+void TransferScheduler::begin()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_depth++ > 0)
+        return;
+
+    m_cancelled = false;
+    m_paths.clear();
+    m_errors.clear();
+    m_total = 0;
+    m_done = 0;
+
+    _start_workers();
+}
+
+bool TransferScheduler::is_active()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_depth > 0;
+}
+
+bool TransferScheduler::is_queued(const std::string &connection, const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_paths.find(std::make_pair(connection, path)) != m_paths.end();
+}
+
+bool TransferScheduler::enqueue(TransferTask task, std::function<bool ()> poll)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_cancelled)
+            return false;
+
+        m_paths.insert(std::make_pair(task.connection, task.path));
+        m_queue.push_back(std::move(task));
+        m_total++;
+    }
+    m_cv.notify_all();
+
+    // caller is not let too far ahead of workers
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(!m_cancelled && m_queue.size() > m_workers.size() * TRANSFER_QUEUE_PER_WORKER){
+        lock.unlock();
+        if(poll && !poll())
+            cancel();
+        lock.lock();
+
+        m_cv.wait_for(lock, std::chrono::milliseconds(100));
+    }
+
+    return !m_cancelled;
+}
+
+bool TransferScheduler::end(std::function<bool (size_t done, size_t total)> poll,
+                            std::vector<std::string> &errors, std::set<std::pair<std::string, std::string>> &paths)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(m_depth == 0 || --m_depth > 0)
+        return false;
+
+    while(m_done < m_total){
+        size_t done = m_done, total = m_total;
+        lock.unlock();
+        if(poll && !poll(done, total))
+            cancel();
+        lock.lock();
+
+        m_cv.wait_for(lock, std::chrono::milliseconds(100));
+    }
+
+    bool hasTasks = m_total > 0;
+    errors.swap(m_errors);
+    paths.swap(m_paths);
+    m_errors.clear();
+    m_paths.clear();
+    m_total = 0;
+    m_done = 0;
+
+    return hasTasks;
+}
+
+void TransferScheduler::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cancelled = true;
+        m_done += m_queue.size();
+        m_queue.clear();
+
+        for(auto progress: m_running)
+            progress->cancel();
+    }
+    m_cv.notify_all();
+}
+
+void TransferScheduler::_start_workers()
+{
+    if(!m_workers.empty())
+        return;
+
+    for(int i=0; i<std::max(m_workers_count, 1); i++)
+        m_workers.emplace_back(&TransferScheduler::_worker, this);
+}
+
+bool TransferScheduler::_pop(TransferTask &task)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while(true){
+        if(m_stop)
+            return false;
+
+        // first task of connection which has free slot
+        for(auto it = m_queue.begin(); it != m_queue.end(); ++it){
+            if(m_active[it->connection] < std::max(it->connection_limit, 1)){
+                task = std::move(*it);
+                m_queue.erase(it);
+                m_active[task.connection]++;
+                return true;
+            }
+        }
+
+        m_cv.wait(lock);
+    }
+}
+
+void TransferScheduler::_worker()
+{
+    TransferTask task;
+    while(_pop(task)){
+        TransferProgress progress(nullptr);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running.insert(&progress);
+        }
+
+        try{
+            task.run(task.client, progress);
+        } catch (transfer_cancelled_exception & e){
+            // operation is cancelled, there is nothing to report
+        } catch (std::exception & e){
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_errors.push_back(task.path + ": " + e.what());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running.erase(&progress);
+            m_active[task.connection]--;
+            m_done++;
+        }
+        m_cv.notify_all();
+
+        task = TransferTask();
+    }
+}
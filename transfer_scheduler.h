@@ -0,0 +1,105 @@
+/*
+Wfx plugin for working with cloud storage services
+
+Copyright (C) 2019 Ivanenko Danil (ivanenko.danil@gmail.com)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+        License as published by the Free Software Foundation; either
+        version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+        Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+        Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifndef CLOUD_STORAGE_TRANSFER_SCHEDULER_H
+#define CLOUD_STORAGE_TRANSFER_SCHEDULER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "service_clients/service_client.h"
+
+#define DEFAULT_TRANSFER_WORKERS 4
+#define DEFAULT_TRANSFER_CONCURRENCY 4
+
+// files up to this size are transferred in background during multi-file operations
+#define BACKGROUND_TRANSFER_MAX_SIZE (16 * 1024 * 1024)
+
+// caller waits while there are more queued tasks per worker
+#define TRANSFER_QUEUE_PER_WORKER 4
+
+struct TransferTask {
+    std::string connection;
+    std::string path;  // remote path, its folder is invalidated when operation ends
+    int connection_limit = DEFAULT_TRANSFER_CONCURRENCY;
+
+    // client of the connection, it is shared with the main thread
+    ServiceClient* client = NULL;
+    std::function<void (ServiceClient* client, TransferProgress& progress)> run;
+};
+
+// Background transfers of one multi-file operation, between FsStatusInfoW start and end.
+// Fixed pool of workers runs tasks with limited number of parallel tasks per connection.
+class TransferScheduler {
+public:
+    ~TransferScheduler();
+
+    // applied when workers are started
+    void set_workers(int count) { m_workers_count = count; }
+
+    // start of operation, calls can be nested
+    void begin();
+
+    // tasks are accepted only inside of operation
+    bool is_active();
+
+    // remote path is queued in current operation
+    bool is_queued(const std::string& connection, const std::string& path);
+
+    // blocks while queue is full, poll is called meanwhile and returns false to cancel operation,
+    // returns false if operation is cancelled
+    bool enqueue(TransferTask task, std::function<bool ()> poll);
+
+    // waits for all tasks of the outermost operation, poll gets count of finished and all tasks,
+    // returns false if there were no tasks or operation is still active
+    bool end(std::function<bool (size_t done, size_t total)> poll,
+             std::vector<std::string>& errors, std::set<std::pair<std::string, std::string>>& paths);
+
+    void cancel();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::thread> m_workers;
+    int m_workers_count = DEFAULT_TRANSFER_WORKERS;
+    bool m_stop = false;
+
+    int m_depth = 0;
+    bool m_cancelled = false;
+    std::deque<TransferTask> m_queue;
+    std::map<std::string, int> m_active;
+    std::set<TransferProgress*> m_running;
+    std::set<std::pair<std::string, std::string>> m_paths;
+    std::vector<std::string> m_errors;
+    size_t m_total = 0;
+    size_t m_done = 0;
+
+    void _start_workers();
+    void _worker();
+    bool _pop(TransferTask& task);
+};
+
+#endif //CLOUD_STORAGE_TRANSFER_SCHEDULER_H